@@ -70,6 +70,15 @@ void Acsi::process(uint8_t cmd) {
   dbg(" ");
 #endif
 
+#if ACSI_SD_LAZY_INIT
+  if(blockDev.initPending && cmdBuf[0] != 0x03) {
+    // The SD card is being initialized in the background
+    dbg("Not ready ");
+    commandStatus(ERR_NOTREADY);
+    return;
+  }
+#endif
+
   // Command preprocessing
   switch(cmdBuf[0]) {
   case 0x08: // Read block
@@ -496,6 +505,14 @@ Acsi::ScsiErr Acsi::processBlockRead(uint32_t block, int count) {
     return ERR_INVADDR;
   }
 
+#if ACSI_BOOT_PREFETCH
+  if(bootRecording) {
+    bootRecord(blockDev.slot, block, count);
+    if(bootCacheRead(blockDev.slot, block, count))
+      return ERR_OK;
+  }
+#endif
+
   if(!blockDev->readStart(block)) {
     dbg("Read error ");
     return ERR_READERR;
@@ -537,6 +554,11 @@ Acsi::ScsiErr Acsi::processBlockWrite(uint32_t block, int count) {
   if(!blockDev->isWritable())
     return ERR_WRITEPROT;
 
+#if ACSI_BOOT_PREFETCH
+  // Prefetched blocks may become stale
+  bootCacheCount = 0;
+#endif
+
   if(!blockDev->writeStart(block)) {
     dbg("Write error ");
     return ERR_WRITEERR;
@@ -620,6 +642,216 @@ void Acsi::modeSense4(uint8_t *outBuf) {
 
 // Static variables
 
+#if ACSI_BOOT_PREFETCH
+void Acsi::bootStart() {
+  if(bootRunCount) {
+    // Replay the previous boot if the STM32 stayed powered
+    memcpy(bootReplay, bootRuns, sizeof(bootRuns));
+    bootReplayCount = bootRunCount;
+  } else {
+    // Load the recording stored next to a disk image
+    bootReplayCount = 0;
+    for(int c = 0; c < sdCount; ++c)
+      bootLoad(c);
+  }
+
+  dbg("Boot runs:", bootReplayCount, ' ');
+
+  bootRunCount = 0;
+  bootReplayRun = 0;
+  bootReplayOffset = 0;
+  bootCacheHead = 0;
+  bootCacheCount = 0;
+  bootStartTime = millis();
+  bootRecording = true;
+}
+
+void Acsi::bootLoad(int slot) {
+  if(bootReplayCount)
+    // Already loaded
+    return;
+
+  SdDev &sd = sdSlots[slot];
+#if ACSI_SD_LAZY_INIT
+  if(sd.initPending)
+    // Loaded by Devices::lazyInit when the card is ready
+    return;
+#endif
+  if(sd.mode != SdDev::ACSI || !sd.image)
+    return;
+
+  FsFile file = sd.fs.open(ACSI_BOOT_PREFETCH_FILE);
+  if(!file)
+    return;
+
+  int size = file.read(bootReplay, sizeof(bootReplay));
+  file.close();
+  if(size > 0)
+    bootReplayCount = size / sizeof(BootRun);
+}
+
+void Acsi::onIdle() {
+  if(!bootRecording)
+    return;
+
+  if(millis() - bootStartTime >= ACSI_BOOT_PREFETCH_TIME) {
+    bootRecording = false;
+    bootCacheCount = 0;
+    bootSave();
+    return;
+  }
+
+  bootPrefetch();
+}
+
+void Acsi::bootRecord(int slot, uint32_t block, int count) {
+  // Extend the last run if the read is contiguous
+  if(bootRunCount) {
+    BootRun &last = bootRuns[bootRunCount - 1];
+    if(last.slot == slot && last.block + last.count == block
+        && last.count + count <= 0xffff) {
+      last.count += count;
+      return;
+    }
+  }
+
+  if(bootRunCount >= ACSI_BOOT_PREFETCH_RUNS)
+    return;
+
+  BootRun &run = bootRuns[bootRunCount++];
+  run.block = block;
+  run.count = count;
+  run.slot = slot;
+}
+
+void Acsi::bootSave() {
+  // Nothing changed since the previous boot
+  if(!bootRunCount || (bootRunCount == bootReplayCount
+        && !memcmp(bootRuns, bootReplay, bootRunCount * sizeof(BootRun))))
+    return;
+
+  for(int c = 0; c < sdCount; ++c) {
+    SdDev &sd = sdSlots[c];
+    if(sd.mode != SdDev::ACSI || !sd.image || !sd.isWritable())
+      continue;
+
+    dbg("Save boot runs ");
+    FsFile file = sd.fs.open(ACSI_BOOT_PREFETCH_FILE, O_CREAT | O_TRUNC | O_WRONLY);
+    if(!file)
+      continue;
+
+    file.write(bootRuns, bootRunCount * sizeof(BootRun));
+    file.close();
+    return;
+  }
+}
+
+void Acsi::bootPrefetch() {
+  if(bootCacheCount >= bootCacheMax)
+    return;
+
+  // Find the next block to prefetch
+  while(bootReplayRun < bootReplayCount
+      && bootReplayOffset >= bootReplay[bootReplayRun].count) {
+    ++bootReplayRun;
+    bootReplayOffset = 0;
+  }
+  if(bootReplayRun >= bootReplayCount)
+    return;
+
+  const BootRun &run = bootReplay[bootReplayRun];
+  if(run.slot < 0 || run.slot >= sdCount) {
+    // Corrupted recording
+    bootReplayCount = 0;
+    return;
+  }
+  uint32_t block = run.block + bootReplayOffset;
+  SdDev &sd = sdSlots[run.slot];
+
+  // Read as many consecutive blocks as the ring allows in one SD command
+  int tail = (bootCacheHead + bootCacheCount) % bootCacheMax;
+  int count = run.count - bootReplayOffset;
+  if(count > bootCacheMax - bootCacheCount)
+    count = bootCacheMax - bootCacheCount;
+  if(count > bootCacheMax - tail)
+    count = bootCacheMax - tail;
+  if(count > ACSI_BLOCKS)
+    count = ACSI_BLOCKS;
+
+  bootReplayOffset += count;
+
+  uint32_t mediaId = sd.mediaId(BlockDev::CACHED);
+  if(sd.mode != SdDev::ACSI || !mediaId || block + count > sd->blocks)
+    return;
+
+  if(!sd->readStart(block))
+    return;
+  bool success = sd->readData(bootCacheData[tail], count);
+  sd->readStop();
+  if(!success)
+    return;
+
+  for(int i = 0; i < count; ++i) {
+    bootCacheBlock[tail + i] = block + i;
+    bootCacheMediaId[tail + i] = mediaId;
+    bootCacheSlot[tail + i] = run.slot;
+  }
+  bootCacheCount += count;
+}
+
+bool Acsi::bootCacheRead(int slot, uint32_t block, int count) {
+  uint32_t mediaId = sdSlots[slot].mediaId(BlockDev::CACHED);
+
+  // Find the first block
+  int first;
+  for(first = 0; first < bootCacheCount; ++first) {
+    int i = (bootCacheHead + first) % bootCacheMax;
+    if(bootCacheSlot[i] == slot && bootCacheBlock[i] == block
+        && bootCacheMediaId[i] == mediaId)
+      break;
+  }
+  if(first >= bootCacheCount)
+    return false;
+
+  // Blocks before it were not requested: the ST took another way
+  bootCacheHead = (bootCacheHead + first) % bootCacheMax;
+  bootCacheCount -= first;
+
+  // Check that the following blocks are there
+  if(count > bootCacheCount)
+    return false;
+  for(int b = 1; b < count; ++b) {
+    int i = (bootCacheHead + b) % bootCacheMax;
+    if(bootCacheSlot[i] != slot || bootCacheBlock[i] != block + b)
+      return false;
+  }
+
+  dbg("Prefetched ");
+  for(int b = 0; b < count; ++b) {
+    DmaPort::sendDma(bootCacheData[bootCacheHead], ACSI_BLOCKSIZE);
+    bootCacheHead = (bootCacheHead + 1) % bootCacheMax;
+    --bootCacheCount;
+  }
+
+  return true;
+}
+
+bool Acsi::bootRecording = false;
+uint32_t Acsi::bootStartTime;
+Acsi::BootRun Acsi::bootRuns[ACSI_BOOT_PREFETCH_RUNS];
+int Acsi::bootRunCount = 0;
+Acsi::BootRun Acsi::bootReplay[ACSI_BOOT_PREFETCH_RUNS];
+int Acsi::bootReplayCount = 0;
+int Acsi::bootReplayRun;
+int Acsi::bootReplayOffset;
+uint32_t Acsi::bootCacheBlock[Acsi::bootCacheMax];
+uint32_t Acsi::bootCacheMediaId[Acsi::bootCacheMax];
+int8_t Acsi::bootCacheSlot[Acsi::bootCacheMax];
+uint8_t Acsi::bootCacheData[Acsi::bootCacheMax][ACSI_BLOCKSIZE];
+int Acsi::bootCacheHead;
+int Acsi::bootCacheCount;
+#endif
+
 int Acsi::cmdLen;
 uint8_t Acsi::cmdBuf[16];
 
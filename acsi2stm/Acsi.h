@@ -40,6 +40,7 @@ public:
     ERR_INVLUN = 0x002505,
     ERR_MEDIUMCHANGE = 0x002806,
     ERR_NOMEDIUM = 0x003a02,
+    ERR_NOTREADY = 0x010402,
   };
 
   enum MediumState {
@@ -102,6 +103,50 @@ public:
   // Command buffer
   static int cmdLen;
   static uint8_t cmdBuf[16];
+#if ACSI_BOOT_PREFETCH
+  // Boot block prefetch
+  struct BootRun {
+    uint32_t block;
+    uint16_t count;
+    int16_t slot;
+  };
+
+  // Start recording block reads. Called after a reset.
+  static void bootStart();
+
+  // Load the recording stored next to the disk image of a slot, unless a
+  // recording is already loaded.
+  static void bootLoad(int slot);
+
+  // Record and prefetch while the ST doesn't send commands
+  static void onIdle();
+
+  static void bootRecord(int slot, uint32_t block, int count);
+  static void bootSave();
+  static void bootPrefetch();
+
+  // Send blocks from the prefetch cache. Returns false if they are not all in
+  // the cache.
+  static bool bootCacheRead(int slot, uint32_t block, int count);
+
+  static bool bootRecording;
+  static uint32_t bootStartTime;
+  static BootRun bootRuns[ACSI_BOOT_PREFETCH_RUNS]; // Reads of this boot
+  static int bootRunCount;
+  static BootRun bootReplay[ACSI_BOOT_PREFETCH_RUNS]; // Reads of the previous boot
+  static int bootReplayCount;
+  static int bootReplayRun; // Next run to prefetch
+  static int bootReplayOffset; // Next block in this run
+
+  // Ring of prefetched blocks, in replay order
+  static const int bootCacheMax = ACSI_BOOT_PREFETCH;
+  static uint32_t bootCacheBlock[bootCacheMax];
+  static uint32_t bootCacheMediaId[bootCacheMax];
+  static int8_t bootCacheSlot[bootCacheMax];
+  static uint8_t bootCacheData[bootCacheMax][ACSI_BLOCKSIZE];
+  static int bootCacheHead; // Oldest block
+  static int bootCacheCount;
+#endif
 };
 
 #endif
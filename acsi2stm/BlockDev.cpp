@@ -19,7 +19,7 @@
 
 #include "SdFat.h"
 #if ! ACSI_STRICT
-#include "TinyFile.h"
+#include "GemDrive.h"
 #endif
 
 static const uint32_t sdRates[] = {
@@ -192,6 +192,11 @@ void SdDev::init() {
 
   dbg("\n        SD", slot, ' ');
 
+#if ACSI_SD_WARM_RESET
+  if(warmInit())
+    return;
+#endif
+
   unsigned int rate;
   for(rate = 0; rate < sizeof(sdRates)/sizeof(sdRates[0]); ++rate) {
     for(int i = 0; i < 2; ++i)
@@ -214,68 +219,142 @@ beginOk:
       continue;
     }
 
-    // Get SD card size
-    blocks = card.sectorCount();
+    if(!mount())
+      continue;
+
+    break;
+  }
+
+  if(!lastMediaId) {
+    dbg("no SD ");
+    reset();
+  }
+}
+
+bool SdDev::mount() {
+  bootable = false;
+#if ! ACSI_STRICT
+  mountable = false;
+#endif
+
+  // Get SD card size
+  blocks = card.sectorCount();
 
 #if ACSI_MAX_BLOCKS
-    if(blocks > ACSI_MAX_BLOCKS)
-      blocks = ACSI_MAX_BLOCKS;
+  if(blocks > ACSI_MAX_BLOCKS)
+    blocks = ACSI_MAX_BLOCKS;
 #endif
 
-    dbg(blocks, " blocks ", writable ? "rw ":"ro ");
+  dbg(blocks, " blocks ", writable ? "rw ":"ro ");
 
-    if(!blocks)
-      continue;
+  if(!blocks)
+    return false;
 
-    // Get writable pin status
+  // Get writable pin status
 #if !ACSI_SD_WRITE_LOCK
-    writable = true;
+  writable = true;
 #elif ACSI_SD_WRITE_LOCK == 1
-    writable = digitalRead(wpPin);
+  writable = digitalRead(wpPin);
 #elif ACSI_SD_WRITE_LOCK == 2
-    writable = !digitalRead(wpPin);
+  writable = !digitalRead(wpPin);
 #endif
 
-    uint32_t id = mediaId(FORCE);
+  // Update lastMediaId
+  mediaId(FORCE);
 
-    // Open the file system
-    image.close();
-    if(fs.begin(&card))
+  // Open the file system
+  image.close();
+  if(fs.begin(&card))
 #if ACSI_PIO
-      {}
+    {}
 #else
-      image.open(ACSI_IMAGE_FILE);
+    image.open(ACSI_IMAGE_FILE);
 
-    // Check if bootable
-    if(!(*this)->updateBootable())
-      continue;
+  // Check if bootable
+  if(!(*this)->updateBootable())
+    return false;
 #endif
 
-
 #if ! ACSI_STRICT
-    if(fs.fatType() && !image && !bootable)
-      mountable = true;
+  if(fs.fatType() && !image && !bootable)
+    mountable = true;
 #endif
 
-    if(image)
-      dbg("image ");
-    if(mountable)
-      dbg("mountable ");
-    if(bootable)
-      dbg("boot ");
+  if(image)
+    dbg("image ");
+  if(mountable)
+    dbg("mountable ");
+  if(bootable)
+    dbg("boot ");
 
-    break;
-  }
+  return true;
+}
 
-  if(!lastMediaId) {
-    dbg("no SD ");
-    reset();
-  }
+#if ACSI_SD_WARM_RESET
+bool SdDev::warmInit() {
+  if(!lastMediaId)
+    return false;
+
+  // A reset may have interrupted a transfer
+  if(!card.syncDevice())
+    return false;
+
+  // Check that the same card is still there
+  uint32_t id = lastMediaId;
+  if(mediaId(FORCE) != id)
+    return false;
+
+  // Files may have been changed, renamed or deleted at the root, and raw
+  // writes may have changed the partition table: mount again, without the
+  // slow card initialization
+  if(!mount())
+    return false;
+
+  dbg("warm ");
+  return true;
 }
+#endif
 
 void SdDev::onReset() {
+  if(!senseSlot())
+    return;
+
+  // Try to initialize the SD card
+  init();
+  attach();
+}
+
+#if ACSI_SD_LAZY_INIT
+void SdDev::onLazyReset() {
+  if(!senseSlot())
+    return;
+
+  // Answer NOT READY on the ACSI bus until initialized
+  initPending = true;
+#if ! ACSI_PIO
+  attachAcsi(slot);
+#endif
+}
+
+bool SdDev::lazyInit() {
+  if(!initPending)
+    return false;
+
+  initPending = false;
+  Devices::detach(slot);
+  init();
+  attach();
+
+  return true;
+}
+#endif
+
+bool SdDev::senseSlot() {
   // Detach from ACSI bus
   Devices::detach(slot);
+#if ACSI_SD_LAZY_INIT
+  initPending = false;
+#endif
 
   // Check if the device is disabled (wpPin pin to VCC)
   pinMode(wpPin, INPUT_PULLDOWN);
@@ -284,13 +363,14 @@ void SdDev::onReset() {
     // wpPin pin to VCC: unit disabled
     pinMode(wpPin, INPUT_PULLUP);
     disable();
-    return;
+    return false;
   }
 
-  // Try to initialize the SD card
   mode = ACSI; // Enable the slot
-  init();
+  return true;
+}
 
+void SdDev::attach() {
   mode = computeMode();
 
   // Attach to the ACSI bus if not disabled
@@ -307,6 +387,18 @@ void SdDev::onReset() {
 #endif
 }
 
+void SdDev::onIdle() {
+  if(mode == DISABLED)
+    return;
+#if ACSI_SD_LAZY_INIT
+  if(initPending)
+    return;
+#endif
+
+  if(millis() - lastMediaCheckTime > mediaCheckPeriod)
+    mediaId(PROBE);
+}
+
 void SdDev::getDeviceString(char *target) {
   // Characters:  0         1         2
   //              012345678901234567890123  4567
@@ -379,7 +471,12 @@ bool SdDev::readData(uint8_t *data, int count) {
 }
 
 bool SdDev::readStop() {
-  return card.readStop();
+  if(!card.readStop())
+    return false;
+
+  // A successful transfer proves that the card is still there
+  lastMediaCheckTime = millis();
+  return true;
 }
 
 bool SdDev::writeStart(uint32_t block) {
@@ -429,7 +526,12 @@ bool SdDev::writeStop() {
 #else
   if(!writable)
     return false;
-  return card.writeStop();
+  if(!card.writeStop())
+    return false;
+
+  // A successful transfer proves that the card is still there
+  lastMediaCheckTime = millis();
+  return true;
 #endif
 }
 
@@ -440,26 +542,38 @@ bool SdDev::isWritable() {
 uint32_t SdDev::mediaId(BlockDev::MediaIdMode mediaIdMode) {
   if(mode == DISABLED)
     return 0;
+#if ACSI_SD_LAZY_INIT
+  if(initPending)
+    // Don't let the recovery path initialize the card
+    return 0;
+#endif
 
   verbose("id", slot, " ", mediaIdMode ," ");
 
   uint32_t now = millis();
-  if(mediaIdMode != BlockDev::FORCE) {
-    if(mediaIdMode == BlockDev::CACHED || now - lastMediaCheckTime <= mediaCheckPeriod) {
-      verbose("cached ");
-      return lastMediaId;
-    }
+  if(mediaIdMode == BlockDev::CACHED
+  || (mediaIdMode == BlockDev::NORMAL && now - lastMediaCheckTime <= mediaCheckTimeout)) {
+    verbose("cached ");
+    return lastMediaId;
   }
 
   lastMediaCheckTime = now;
 
+  if(mediaIdMode != BlockDev::FORCE && lastMediaId && !card.status()) {
+    // SEND_STATUS is much cheaper than reading the CID. A swapped card
+    // needs to be initialized before answering, so this is enough to
+    // detect swaps.
+    verbose("present ");
+    return lastMediaId;
+  }
+
   cid_t cid;
   if(!card.readCID(&cid)) {
     // SD has an issue
     verbose("CID error ");
 
 #if ! ACSI_STRICT
-    TinyFile::ejected(lastMediaId);
+    GemDrive::ejected(lastMediaId);
 #endif
     lastMediaId = 0;
 
@@ -28,9 +28,10 @@
 class BlockDev: public Monitor, public Devices {
 public:
   enum MediaIdMode {
-    NORMAL, // Refresh cache after some time has passed
+    NORMAL, // Refresh cache after a long time without any check
     FORCE, // Don't use cache, don't reinit a failed drive
     CACHED, // Return the value in cache
+    PROBE, // Check that the card is still there, refresh cache if not
   };
 
   // Read/write functions
@@ -108,6 +109,17 @@ public:
 
   void onReset(); // Called at Atari reset
 
+  void onIdle(); // Check the card while the ST is not sending commands
+
+#if ACSI_SD_LAZY_INIT
+  // Like onReset, but leave the card initialization to lazyInit().
+  void onLazyReset();
+
+  // Initialize the card if onLazyReset() was called.
+  // Returns true if the card was initialized.
+  bool lazyInit();
+#endif
+
   void getDeviceString(char *target);
 
   // Return the actual block device (SD card or image)
@@ -130,6 +142,16 @@ public:
   // Get the actual mode
   Mode computeMode();
 
+#if ACSI_SD_WARM_RESET
+  // Reuse the state of the previous init if the card did not change.
+  // Returns false if a full init is needed.
+  bool warmInit();
+#endif
+
+  // Mount the file system of an initialized card.
+  // Returns false if the card cannot be used.
+  bool mount();
+
   SdSpiCard card;
   FsVolume fs;
   ImageDev image;
@@ -137,6 +159,9 @@ public:
   Mode mode;
 
   bool writable;
+#if ACSI_SD_LAZY_INIT
+  bool initPending; // Card not initialized yet by lazyInit()
+#endif
 #if ! ACSI_STRICT
   bool mountable;
 #else
@@ -148,10 +173,17 @@ public:
 
   friend class ImageDev;
 protected:
-  static const uint32_t mediaCheckPeriod = 500;
+  static const uint32_t mediaCheckPeriod = 500; // Period of idle checks
+  static const uint32_t mediaCheckTimeout = 2000; // Check age for NORMAL mode
   uint32_t lastMediaId;
   uint32_t lastMediaCheckTime;
   void reset();
+
+  // Detach the slot and check if it is enabled
+  bool senseSlot();
+
+  // Attach the slot according to the card state
+  void attach();
 };
 
 #endif
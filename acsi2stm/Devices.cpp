@@ -77,6 +77,8 @@ GemDrive Devices::drives[] = {
 #endif
 
 void Devices::sense() {
+  uint32_t start = micros();
+
 #if ACSI_RTC
   FsDateTime::setCallback(getDateTime);
 #endif
@@ -111,15 +113,72 @@ end:
 #endif
 
 #if ! ACSI_STRICT
-  GemDrive::closeAll();
+  GemDrive::onReset();
+#endif
+#if ACSI_SD_LAZY_INIT
+  bool lazy = false;
 #endif
   for(int c = 0; c < sdCount; ++c) {
+#if ACSI_SD_LAZY_INIT
+    if(lazy)
+      sdSlots[c].onLazyReset();
+    else
+#endif
     sdSlots[c].onReset();
+#if ACSI_SD_LAZY_INIT
+    // Only the first enabled slot is initialized right away
+    if(sdSlots[c].mode != SdDev::DISABLED)
+      lazy = true;
+#endif
+#if ! ACSI_PIO
+    acsi[c].onReset();
+#endif
+  }
+#if ! ACSI_PIO && ACSI_BOOT_PREFETCH
+  Acsi::bootStart();
+#endif
+  // Time from reset to ready, to check the warm reset path
+  Monitor::dbg("\nReady in ", micros() - start, "us\n");
+}
+
+void Devices::onIdle() {
+#if ACSI_SD_LAZY_INIT
+  // Give priority to pending SD slots
+  if(lazyInit())
+    return;
+#endif
+  for(int c = 0; c < sdCount; ++c)
+    sdSlots[c].onIdle();
+#if ! ACSI_STRICT
+  GemDrive::onIdle();
+#endif
+#if ! ACSI_PIO && ACSI_BOOT_PREFETCH
+  Acsi::onIdle();
+#endif
+}
+
+#if ACSI_SD_LAZY_INIT
+bool Devices::lazyInit(bool all) {
+  bool done = false;
+  for(int c = 0; c < sdCount; ++c) {
+    if(!sdSlots[c].lazyInit())
+      continue;
+
 #if ! ACSI_PIO
     acsi[c].onReset();
 #endif
+#if ! ACSI_PIO && ACSI_BOOT_PREFETCH
+    // bootStart skipped the slot
+    Acsi::bootLoad(c);
+#endif
+    Monitor::dbg('\n');
+    done = true;
+    if(!all)
+      break;
   }
+  return done;
 }
+#endif
 
 int Devices::acsiDeviceMask = 0;
 #if ! ACSI_STRICT
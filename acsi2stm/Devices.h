@@ -42,6 +42,16 @@ struct Devices {
   // Sense jumper settings
   static void sense();
 
+  // Do background work while the ST is not sending commands
+  static void onIdle();
+
+#if ACSI_SD_LAZY_INIT
+  // Initialize SD slots left pending by sense().
+  // Initializes only one slot unless all is true.
+  // Returns true if a slot was initialized.
+  static bool lazyInit(bool all = false);
+#endif
+
   static const int sdCount = ACSI_SD_CARDS;
   static int acsiDeviceMask;
 #if ! ACSI_STRICT
@@ -299,6 +299,11 @@ uint8_t DmaPort::readCommand() {
   return cmd;
 }
 
+bool DmaPort::pollCommand() {
+  resetTimeout();
+  return checkCommand();
+}
+
 uint8_t DmaPort::waitCommand() {
   do {
     resetTimeout();
@@ -56,6 +56,10 @@ struct DmaPort {
   // then calling readCommand.
   static uint8_t waitCommand();
 
+  // Check the RST line and return true if a new command is available.
+  // Use this instead of waitCommand to do background work while idle.
+  static bool pollCommand();
+
   // Read bytes using the IRQ/CS method.
   static void readIrq(uint8_t *bytes, int count);
 
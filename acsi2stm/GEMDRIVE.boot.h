@@ -1,41 +1,45 @@
 unsigned char GEMDRIVE_boot_bin[] = {
-  0x60, 0x00, 0x01, 0x92, 0x00, 0xff, 0x58, 0x42, 0x52, 0x41, 0x41, 0x32,
+  0x60, 0x00, 0x01, 0xbc, 0x00, 0xff, 0x58, 0x42, 0x52, 0x41, 0x41, 0x32,
   0x53, 0x54, 0x00, 0x00, 0x00, 0x84, 0x2f, 0x3a, 0xff, 0xfa, 0x70, 0x0e,
   0x4a, 0x38, 0x04, 0x3e, 0x66, 0x54, 0x48, 0xe7, 0x60, 0xe0, 0x61, 0x5a,
   0x0c, 0x52, 0x00, 0x20, 0x67, 0x40, 0x50, 0xf8, 0x04, 0x3e, 0x61, 0x00,
-  0x01, 0x3a, 0x30, 0xbc, 0x00, 0xff, 0x32, 0xbc, 0x01, 0x88, 0xc0, 0x7c,
+  0x01, 0x64, 0x30, 0xbc, 0x00, 0xff, 0x32, 0xbc, 0x01, 0x88, 0xc0, 0x7c,
   0x00, 0xff, 0x30, 0x80, 0x32, 0xbc, 0x01, 0x00, 0x08, 0x38, 0x00, 0x05,
   0xfa, 0x01, 0x66, 0xf8, 0x32, 0xbc, 0x00, 0x8a, 0x30, 0x10, 0xb0, 0x3c,
-  0x00, 0x9a, 0x67, 0x12, 0x6d, 0x3a, 0x48, 0x80, 0x48, 0xc0, 0x51, 0xf8,
+  0x00, 0x9a, 0x67, 0x12, 0x6d, 0x4c, 0x48, 0x80, 0x48, 0xc0, 0x51, 0xf8,
   0x04, 0x3e, 0x4c, 0xdf, 0x07, 0x06, 0x58, 0x4f, 0x4e, 0x73, 0x51, 0xf8,
   0x04, 0x3e, 0x4c, 0xdf, 0x07, 0x06, 0x4e, 0x75, 0x48, 0xe7, 0x60, 0xe0,
   0xc0, 0x7c, 0x00, 0xe0, 0x60, 0xac, 0x08, 0x2f, 0x00, 0x05, 0x00, 0x1c,
   0x67, 0x0a, 0x34, 0x3a, 0xff, 0x7c, 0x45, 0xf7, 0x20, 0x1c, 0x4e, 0x75,
   0x4e, 0x6a, 0x4e, 0x75, 0x48, 0x40, 0x74, 0x03, 0x30, 0x10, 0xe1, 0x89,
-  0x12, 0x00, 0x51, 0xca, 0xff, 0xf8, 0x48, 0x40, 0x14, 0x00, 0xc4, 0x7c,
-  0x00, 0x7e, 0x34, 0x3b, 0x20, 0x06, 0x4e, 0xfb, 0x20, 0x02, 0x00, 0x18,
-  0x00, 0x86, 0x00, 0x68, 0x00, 0x20, 0x00, 0x1c, 0x00, 0x3a, 0x00, 0x40,
-  0x00, 0x46, 0x00, 0x4c, 0x00, 0x50, 0x00, 0x54, 0x00, 0x58, 0x20, 0x01,
-  0x60, 0x90, 0x70, 0x04, 0x60, 0x02, 0x70, 0x06, 0x51, 0xf8, 0x04, 0x3e,
-  0x61, 0x00, 0xff, 0xa4, 0x54, 0x4a, 0x34, 0xc0, 0x42, 0x9a, 0x24, 0xc1,
-  0x42, 0x9a, 0x4c, 0xdf, 0x07, 0x06, 0x4e, 0x75, 0x20, 0x41, 0x2f, 0x10,
-  0x60, 0x26, 0x20, 0x41, 0x3f, 0x10, 0x60, 0x20, 0x20, 0x41, 0x1f, 0x10,
-  0x60, 0x1a, 0xdf, 0xc1, 0x60, 0x16, 0x3f, 0x01, 0x60, 0x16, 0x2f, 0x0f,
-  0x60, 0x0e, 0x41, 0xfa, 0x00, 0x84, 0x20, 0x80, 0x4e, 0x41, 0x2f, 0x00,
-  0x20, 0x3a, 0x00, 0x7a, 0x22, 0x0f, 0x24, 0x41, 0x08, 0x00, 0x00, 0x00,
-  0x67, 0x32, 0x61, 0x46, 0x32, 0xbc, 0x00, 0x90, 0x30, 0xbc, 0x00, 0xff,
-  0x32, 0xbc, 0x00, 0x8a, 0x42, 0x50, 0x42, 0x51, 0x60, 0x00, 0xff, 0x0e,
-  0x22, 0x4f, 0x34, 0x19, 0x24, 0x49, 0x20, 0x41, 0x08, 0x00, 0x00, 0x00,
-  0x67, 0x08, 0x10, 0xd9, 0x51, 0xca, 0xff, 0xfc, 0x60, 0xd4, 0x12, 0xd8,
-  0x51, 0xca, 0xff, 0xfc, 0x61, 0x14, 0x30, 0xbc, 0x00, 0xff, 0x32, 0xbc,
-  0x01, 0x8a, 0x30, 0xbc, 0x00, 0x88, 0x32, 0xbc, 0x01, 0x00, 0x60, 0x00,
-  0xfe, 0xdc, 0x4c, 0xba, 0x03, 0x00, 0x00, 0x1e, 0x32, 0xbc, 0x00, 0x90,
-  0x32, 0xbc, 0x01, 0x90, 0x22, 0x0a, 0x11, 0xc1, 0x86, 0x0d, 0xe0, 0x89,
-  0x11, 0xc1, 0x86, 0x0b, 0xe0, 0x89, 0x11, 0xc1, 0x86, 0x09, 0x4e, 0x75,
-  0x86, 0x04, 0x86, 0x06, 0x00, 0x00, 0x00, 0x00, 0x50, 0xf8, 0x04, 0x3e,
-  0x61, 0x00, 0xff, 0xd0, 0x32, 0xbc, 0x00, 0x88, 0x30, 0x3a, 0xfe, 0x74,
-  0xc0, 0x7c, 0x00, 0xe0, 0x72, 0x09, 0x82, 0x00, 0x30, 0x81, 0x08, 0x38,
-  0x00, 0x05, 0xfa, 0x01, 0x66, 0xf8, 0x32, 0xbc, 0x00, 0x8a, 0x30, 0x10,
-  0x4a, 0x00, 0x66, 0xd4, 0x30, 0x3a, 0xfe, 0x54, 0x60, 0x00, 0xfe, 0xae
+  0x12, 0x00, 0x51, 0xca, 0xff, 0xf8, 0x48, 0x40, 0x4e, 0x75, 0x61, 0xec,
+  0x14, 0x00, 0xc4, 0x7c, 0x00, 0x7e, 0x34, 0x3b, 0x20, 0x06, 0x4e, 0xfb,
+  0x20, 0x02, 0x00, 0x1a, 0x00, 0xac, 0x00, 0x8e, 0x00, 0x46, 0x00, 0x42,
+  0x00, 0x60, 0x00, 0x66, 0x00, 0x6c, 0x00, 0x72, 0x00, 0x76, 0x00, 0x7a,
+  0x00, 0x7e, 0x00, 0x1e, 0x20, 0x01, 0x60, 0x8a, 0x34, 0x10, 0x53, 0x02,
+  0x6b, 0x1a, 0x67, 0x14, 0x53, 0x02, 0x61, 0xb4, 0x24, 0x41, 0x61, 0xb0,
+  0x34, 0x01, 0x32, 0x10, 0x14, 0xc1, 0x51, 0xca, 0xff, 0xfa, 0x60, 0xe4,
+  0x61, 0xa2, 0x60, 0xdc, 0x60, 0x00, 0x00, 0x4c, 0x70, 0x04, 0x60, 0x02,
+  0x70, 0x06, 0x51, 0xf8, 0x04, 0x3e, 0x61, 0x00, 0xff, 0x7a, 0x54, 0x4a,
+  0x34, 0xc0, 0x42, 0x9a, 0x24, 0xc1, 0x42, 0x9a, 0x4c, 0xdf, 0x07, 0x06,
+  0x4e, 0x75, 0x20, 0x41, 0x2f, 0x10, 0x60, 0x26, 0x20, 0x41, 0x3f, 0x10,
+  0x60, 0x20, 0x20, 0x41, 0x1f, 0x10, 0x60, 0x1a, 0xdf, 0xc1, 0x60, 0x16,
+  0x3f, 0x01, 0x60, 0x16, 0x2f, 0x0f, 0x60, 0x0e, 0x41, 0xfa, 0x00, 0x84,
+  0x20, 0x80, 0x4e, 0x41, 0x2f, 0x00, 0x20, 0x3a, 0x00, 0x7a, 0x22, 0x0f,
+  0x24, 0x41, 0x08, 0x00, 0x00, 0x00, 0x67, 0x32, 0x61, 0x46, 0x32, 0xbc,
+  0x00, 0x90, 0x30, 0xbc, 0x00, 0xff, 0x32, 0xbc, 0x00, 0x8a, 0x42, 0x50,
+  0x42, 0x51, 0x60, 0x00, 0xfe, 0xe4, 0x22, 0x4f, 0x34, 0x19, 0x24, 0x49,
+  0x20, 0x41, 0x08, 0x00, 0x00, 0x00, 0x67, 0x08, 0x10, 0xd9, 0x51, 0xca,
+  0xff, 0xfc, 0x60, 0xd4, 0x12, 0xd8, 0x51, 0xca, 0xff, 0xfc, 0x61, 0x14,
+  0x30, 0xbc, 0x00, 0xff, 0x32, 0xbc, 0x01, 0x8a, 0x30, 0xbc, 0x00, 0x88,
+  0x32, 0xbc, 0x01, 0x00, 0x60, 0x00, 0xfe, 0xb2, 0x4c, 0xba, 0x03, 0x00,
+  0x00, 0x1e, 0x32, 0xbc, 0x00, 0x90, 0x32, 0xbc, 0x01, 0x90, 0x22, 0x0a,
+  0x11, 0xc1, 0x86, 0x0d, 0xe0, 0x89, 0x11, 0xc1, 0x86, 0x0b, 0xe0, 0x89,
+  0x11, 0xc1, 0x86, 0x09, 0x4e, 0x75, 0x86, 0x04, 0x86, 0x06, 0x00, 0x00,
+  0x00, 0x00, 0x50, 0xf8, 0x04, 0x3e, 0x61, 0x00, 0xff, 0xd0, 0x32, 0xbc,
+  0x00, 0x88, 0x30, 0x3a, 0xfe, 0x4a, 0xc0, 0x7c, 0x00, 0xe0, 0x72, 0x09,
+  0x82, 0x00, 0x30, 0x81, 0x08, 0x38, 0x00, 0x05, 0xfa, 0x01, 0x66, 0xf8,
+  0x32, 0xbc, 0x00, 0x8a, 0x30, 0x10, 0x4a, 0x00, 0x66, 0xd4, 0x30, 0x3a,
+  0xfe, 0x2a, 0x60, 0x00, 0xfe, 0x84
 };
-unsigned int GEMDRIVE_boot_bin_len = 456;
+unsigned int GEMDRIVE_boot_bin_len = 498;
@@ -0,0 +1,96 @@
+unsigned char GEMDRIVE_drv_bin[] = {
+  0x60, 0x00, 0x00, 0x74, 0x00, 0xff, 0x58, 0x42, 0x52, 0x41, 0x41, 0x32,
+  0x53, 0x54, 0x00, 0x00, 0x00, 0x84, 0x2f, 0x3a, 0xff, 0xfa, 0x70, 0x0e,
+  0x4a, 0x38, 0x04, 0x3e, 0x66, 0x58, 0x48, 0xe7, 0x60, 0xe0, 0x61, 0x5e,
+  0x0c, 0x52, 0x00, 0x20, 0x67, 0x44, 0x60, 0x00, 0x02, 0x80, 0x50, 0xf8,
+  0x04, 0x3e, 0x61, 0x00, 0x02, 0x4e, 0x30, 0xbc, 0x00, 0xff, 0x32, 0xbc,
+  0x01, 0x88, 0xc0, 0x7c, 0x00, 0xff, 0x30, 0x80, 0x32, 0xbc, 0x01, 0x00,
+  0x08, 0x38, 0x00, 0x05, 0xfa, 0x01, 0x66, 0xf8, 0x32, 0xbc, 0x00, 0x8a,
+  0x30, 0x10, 0xb0, 0x3c, 0x00, 0x9a, 0x67, 0x12, 0x6d, 0x4c, 0x48, 0x80,
+  0x48, 0xc0, 0x51, 0xf8, 0x04, 0x3e, 0x4c, 0xdf, 0x07, 0x06, 0x58, 0x4f,
+  0x4e, 0x73, 0x51, 0xf8, 0x04, 0x3e, 0x4c, 0xdf, 0x07, 0x06, 0x4e, 0x75,
+  0x48, 0xe7, 0x60, 0xe0, 0xc0, 0x7c, 0x00, 0xe0, 0x60, 0xac, 0x08, 0x2f,
+  0x00, 0x05, 0x00, 0x1c, 0x67, 0x0a, 0x34, 0x3a, 0xff, 0x78, 0x45, 0xf7,
+  0x20, 0x1c, 0x4e, 0x75, 0x4e, 0x6a, 0x4e, 0x75, 0x48, 0x40, 0x74, 0x03,
+  0x30, 0x10, 0xe1, 0x89, 0x12, 0x00, 0x51, 0xca, 0xff, 0xf8, 0x48, 0x40,
+  0x4e, 0x75, 0x61, 0xec, 0x14, 0x00, 0xc4, 0x7c, 0x00, 0x7e, 0x34, 0x3b,
+  0x20, 0x06, 0x4e, 0xfb, 0x20, 0x02, 0x00, 0x1a, 0x01, 0x96, 0x01, 0x78,
+  0x01, 0x30, 0x01, 0x2c, 0x01, 0x4a, 0x01, 0x50, 0x01, 0x56, 0x01, 0x5c,
+  0x01, 0x60, 0x01, 0x64, 0x01, 0x68, 0x00, 0x1e, 0x20, 0x01, 0x60, 0x8a,
+  0x34, 0x10, 0x53, 0x02, 0x6b, 0x2c, 0x67, 0x26, 0x53, 0x02, 0x67, 0x10,
+  0x53, 0x02, 0x67, 0x26, 0x53, 0x02, 0x66, 0x00, 0x00, 0x96, 0x61, 0xa8,
+  0x60, 0x00, 0x01, 0x40, 0x61, 0xa2, 0x24, 0x41, 0x61, 0x9e, 0x34, 0x01,
+  0x32, 0x10, 0x14, 0xc1, 0x51, 0xca, 0xff, 0xfa, 0x60, 0xd2, 0x61, 0x90,
+  0x60, 0xca, 0x60, 0x00, 0x01, 0x24, 0x61, 0x88, 0x2f, 0x01, 0x61, 0x84,
+  0x24, 0x41, 0x61, 0x80, 0x48, 0xe7, 0x80, 0xc0, 0x22, 0x6f, 0x00, 0x0c,
+  0x30, 0x09, 0x34, 0x0a, 0xb5, 0x40, 0x08, 0x00, 0x00, 0x00, 0x66, 0x48,
+  0x08, 0x02, 0x00, 0x00, 0x67, 0x08, 0x4a, 0x81, 0x67, 0x42, 0x14, 0xd9,
+  0x53, 0x81, 0x30, 0x01, 0xe4, 0x89, 0x74, 0x07, 0xc4, 0x41, 0xe6, 0x89,
+  0x44, 0x42, 0xd4, 0x42, 0x4e, 0xfb, 0x20, 0x12, 0x24, 0xd9, 0x24, 0xd9,
+  0x24, 0xd9, 0x24, 0xd9, 0x24, 0xd9, 0x24, 0xd9, 0x24, 0xd9, 0x24, 0xd9,
+  0x53, 0x81, 0x6a, 0xec, 0x08, 0x00, 0x00, 0x01, 0x67, 0x02, 0x34, 0xd9,
+  0x08, 0x00, 0x00, 0x00, 0x67, 0x0a, 0x14, 0xd9, 0x60, 0x06, 0x14, 0xd9,
+  0x53, 0x81, 0x6a, 0xfa, 0x4c, 0xdf, 0x03, 0x01, 0x58, 0x8f, 0x60, 0x00,
+  0xff, 0x58, 0x61, 0x00, 0xff, 0x14, 0x24, 0x41, 0x61, 0x00, 0xff, 0x0e,
+  0x22, 0x41, 0x61, 0x00, 0xff, 0x08, 0x24, 0x01, 0x22, 0x09, 0x2f, 0x00,
+  0x30, 0x0a, 0x08, 0x00, 0x00, 0x00, 0x67, 0x08, 0x4a, 0x81, 0x67, 0x3c,
+  0x14, 0xc2, 0x53, 0x81, 0x32, 0x41, 0xe4, 0x89, 0x70, 0x07, 0xc0, 0x41,
+  0xe6, 0x89, 0x44, 0x40, 0xd0, 0x40, 0x4e, 0xfb, 0x00, 0x12, 0x24, 0xc2,
+  0x24, 0xc2, 0x24, 0xc2, 0x24, 0xc2, 0x24, 0xc2, 0x24, 0xc2, 0x24, 0xc2,
+  0x24, 0xc2, 0x53, 0x81, 0x6a, 0xec, 0x30, 0x09, 0x08, 0x00, 0x00, 0x01,
+  0x67, 0x02, 0x34, 0xc2, 0x08, 0x00, 0x00, 0x00, 0x67, 0x02, 0x14, 0xc2,
+  0x20, 0x1f, 0x60, 0x00, 0xfe, 0xf4, 0x70, 0x04, 0x60, 0x02, 0x70, 0x06,
+  0x51, 0xf8, 0x04, 0x3e, 0x61, 0x00, 0xfe, 0x90, 0x54, 0x4a, 0x34, 0xc0,
+  0x42, 0x9a, 0x24, 0xc1, 0x42, 0x9a, 0x4c, 0xdf, 0x07, 0x06, 0x4e, 0x75,
+  0x20, 0x41, 0x2f, 0x10, 0x60, 0x26, 0x20, 0x41, 0x3f, 0x10, 0x60, 0x20,
+  0x20, 0x41, 0x1f, 0x10, 0x60, 0x1a, 0xdf, 0xc1, 0x60, 0x16, 0x3f, 0x01,
+  0x60, 0x16, 0x2f, 0x0f, 0x60, 0x0e, 0x41, 0xfa, 0x00, 0x84, 0x20, 0x80,
+  0x4e, 0x41, 0x2f, 0x00, 0x20, 0x3a, 0x00, 0x7a, 0x22, 0x0f, 0x24, 0x41,
+  0x08, 0x00, 0x00, 0x00, 0x67, 0x32, 0x61, 0x46, 0x32, 0xbc, 0x00, 0x90,
+  0x30, 0xbc, 0x00, 0xff, 0x32, 0xbc, 0x00, 0x8a, 0x42, 0x50, 0x42, 0x51,
+  0x60, 0x00, 0xfd, 0xfa, 0x22, 0x4f, 0x34, 0x19, 0x24, 0x49, 0x20, 0x41,
+  0x08, 0x00, 0x00, 0x00, 0x67, 0x08, 0x10, 0xd9, 0x51, 0xca, 0xff, 0xfc,
+  0x60, 0xd4, 0x12, 0xd8, 0x51, 0xca, 0xff, 0xfc, 0x61, 0x14, 0x30, 0xbc,
+  0x00, 0xff, 0x32, 0xbc, 0x01, 0x8a, 0x30, 0xbc, 0x00, 0x88, 0x32, 0xbc,
+  0x01, 0x00, 0x60, 0x00, 0xfd, 0xc8, 0x4c, 0xba, 0x03, 0x00, 0x00, 0x1e,
+  0x32, 0xbc, 0x00, 0x90, 0x32, 0xbc, 0x01, 0x90, 0x22, 0x0a, 0x11, 0xc1,
+  0x86, 0x0d, 0xe0, 0x89, 0x11, 0xc1, 0x86, 0x0b, 0xe0, 0x89, 0x11, 0xc1,
+  0x86, 0x09, 0x4e, 0x75, 0x86, 0x04, 0x86, 0x06, 0x00, 0x00, 0x00, 0x00,
+  0x32, 0x12, 0xb2, 0x7c, 0x00, 0x80, 0x64, 0x66, 0x43, 0xfa, 0x01, 0x5e,
+  0x34, 0x01, 0xe4, 0x4a, 0x14, 0x31, 0x20, 0x00, 0xc2, 0x7c, 0x00, 0x03,
+  0xd2, 0x41, 0xe2, 0x2a, 0xc4, 0x7c, 0x00, 0x03, 0x55, 0x42, 0x6b, 0x46,
+  0x67, 0x2a, 0x20, 0x6a, 0x00, 0x02, 0x74, 0x1f, 0x0c, 0x28, 0x00, 0x3a,
+  0x00, 0x01, 0x66, 0x06, 0xc4, 0x10, 0x53, 0x42, 0x60, 0x0c, 0x20, 0x7a,
+  0x01, 0x12, 0x20, 0x50, 0x74, 0x00, 0x14, 0x28, 0x00, 0x37, 0x22, 0x3a,
+  0x01, 0x1a, 0x05, 0x01, 0x67, 0x18, 0x60, 0x1e, 0x14, 0x2a, 0x00, 0x02,
+  0x94, 0x3c, 0x00, 0x32, 0xb4, 0x3c, 0x00, 0x07, 0x62, 0x08, 0x12, 0x3a,
+  0x01, 0x06, 0x05, 0x01, 0x66, 0x08, 0x60, 0x00, 0xfd, 0x5a, 0x54, 0x42,
+  0x67, 0xf8, 0x0c, 0x52, 0x00, 0x4f, 0x67, 0x0a, 0x0c, 0x52, 0x00, 0x3f,
+  0x67, 0x00, 0x00, 0x8c, 0x60, 0x64, 0x22, 0x3a, 0x00, 0xd2, 0x67, 0x5e,
+  0x22, 0x41, 0x4a, 0xa9, 0x00, 0x08, 0x67, 0x56, 0x20, 0x7a, 0x00, 0xc0,
+  0x20, 0x50, 0x20, 0x68, 0x00, 0x20, 0x22, 0x08, 0x08, 0x01, 0x00, 0x00,
+  0x66, 0x44, 0xb2, 0xa9, 0x00, 0x00, 0x66, 0x3e, 0x22, 0x69, 0x00, 0x04,
+  0x43, 0xe9, 0xff, 0xd4, 0x74, 0x0a, 0xb1, 0x89, 0x56, 0xca, 0xff, 0xfc,
+  0x66, 0x2c, 0x20, 0x41, 0x24, 0x7a, 0x00, 0x98, 0x70, 0xcf, 0x4a, 0x6a,
+  0x00, 0x08, 0x67, 0x1a, 0x53, 0x6a, 0x00, 0x08, 0x22, 0x6a, 0x00, 0x04,
+  0x06, 0xaa, 0x00, 0x00, 0x00, 0x2c, 0x00, 0x04, 0x74, 0x0a, 0x20, 0xd9,
+  0x51, 0xca, 0xff, 0xfc, 0x70, 0x00, 0x60, 0x00, 0xfc, 0xd6, 0x22, 0x3a,
+  0x00, 0x6a, 0x67, 0x1a, 0x20, 0x41, 0x14, 0x00, 0xe6, 0x0a, 0xc4, 0x7c,
+  0x00, 0x1c, 0x43, 0xfa, 0x00, 0x9c, 0xd2, 0xc2, 0x22, 0x10, 0xb2, 0x91,
+  0x67, 0x04, 0x22, 0x81, 0x53, 0x00, 0x60, 0x00, 0xfc, 0x7e, 0x22, 0x3a,
+  0x00, 0x52, 0x67, 0xd6, 0x22, 0x41, 0x32, 0x2a, 0x00, 0x02, 0x67, 0xce,
+  0xb2, 0x69, 0x00, 0x08, 0x66, 0xc8, 0x24, 0x2a, 0x00, 0x04, 0xb4, 0xa9,
+  0x00, 0x0c, 0x62, 0xbe, 0x52, 0xa9, 0x00, 0x00, 0x95, 0xa9, 0x00, 0x0c,
+  0x20, 0x69, 0x00, 0x10, 0xd5, 0xa9, 0x00, 0x10, 0x24, 0x6a, 0x00, 0x08,
+  0x20, 0x02, 0x60, 0x02, 0x14, 0xd8, 0x51, 0xca, 0xff, 0xfc, 0x60, 0x00,
+  0xfc, 0x72, 0x41, 0x32, 0x45, 0x58, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55,
+  0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55,
+  0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+unsigned int GEMDRIVE_drv_bin_len = 1116;
@@ -35,6 +35,8 @@
 
 const
 #include "GEMDRIVE.boot.h"
+const
+#include "GEMDRIVE.drv.h"
 
 // Character tables
 
@@ -108,6 +110,45 @@ static const uint16_t translitChars[][2] = {
 static const int GEMDRIVE_boot_acsiid = 23;
 static const int GEMDRIVE_boot_prmoff = 4;
 
+#if ! ACSI_PIO
+// GEMDOS calls processed by GemDrive. Other calls are forwarded to TOS by the
+// resident driver without using the ACSI bus.
+static const struct {
+  int16_t op;
+  uint8_t filter;
+} gemdosFilters[] = {
+  { Tos::Pterm0_op, GemDriverVars::SEND },
+#if ACSI_DEBUG
+  { Tos::Cconws_op, GemDriverVars::SEND },
+#endif
+  { Tos::Dsetdrv_op, GemDriverVars::SEND },
+  { Tos::Fsetdta_op, GemDriverVars::SEND },
+  { Tos::Tgetdate_op, GemDriverVars::SEND },
+  { Tos::Tsetdate_op, GemDriverVars::SEND },
+  { Tos::Tgettime_op, GemDriverVars::SEND },
+  { Tos::Tsettime_op, GemDriverVars::SEND },
+  { Tos::Dfree_op, GemDriverVars::SEND },
+  { Tos::Dcreate_op, GemDriverVars::PATH },
+  { Tos::Ddelete_op, GemDriverVars::PATH },
+  { Tos::Dsetpath_op, GemDriverVars::PATH },
+  { Tos::Fcreate_op, GemDriverVars::PATH },
+  { Tos::Fopen_op, GemDriverVars::PATH },
+  { Tos::Fclose_op, GemDriverVars::HANDLE },
+  { Tos::Fread_op, GemDriverVars::HANDLE },
+  { Tos::Fwrite_op, GemDriverVars::HANDLE },
+  { Tos::Fdelete_op, GemDriverVars::PATH },
+  { Tos::Fseek_op, GemDriverVars::SEND },
+  { Tos::Fattrib_op, GemDriverVars::PATH },
+  { Tos::Dgetpath_op, GemDriverVars::SEND },
+  { Tos::Pexec_op, GemDriverVars::SEND },
+  { Tos::Pterm_op, GemDriverVars::SEND },
+  { Tos::Fsfirst_op, GemDriverVars::PATH },
+  { Tos::Fsnext_op, GemDriverVars::SEND },
+  { Tos::Frename_op, GemDriverVars::SEND },
+  { Tos::Fdatime_op, GemDriverVars::SEND },
+};
+#endif
+
 GemPattern::GemPattern() {
   clear();
 }
@@ -268,11 +309,47 @@ bool GemPattern::parseUnicode(const char *name) {
 }
 
 bool GemPattern::parseFileName(FsFile &file) {
+  // Fast path: use the raw short name if the file has no long name
+  const DirFat_t *entry = TinyFile::getShortEntry(file);
+  if(entry && parseShortName(entry))
+    return true;
+
   char unicodeName[256];
   file.getName(unicodeName, sizeof(unicodeName));
   return parseUnicode(unicodeName);
 }
 
+bool GemPattern::parseShortName(const DirFat_t *entry) {
+  const uint8_t *name = entry->name;
+
+  // Dot entries are left to parseUnicode
+  if(name[0] == '.' || name[0] == ' ')
+    return false;
+
+  bool padding = false;
+  for(int i = 0; i < 11; ++i) {
+    uint8_t c = name[i];
+    if(i == 8)
+      padding = false;
+    if(c == ' ') {
+      padding = true;
+    } else if(padding || c < ' ' || c >= 127 || strchr("*.:?\\/", c)) {
+      // Embedded space or non-ASCII character: let parseUnicode decide
+      return false;
+    }
+
+#if ! ACSI_GEMDRIVE_UPPER_CASE
+    // Apply lower case flags like getName does
+    if(c >= 'A' && c <= 'Z'
+        && (entry->caseFlags & (i < 8 ? FAT_CASE_LC_BASE : FAT_CASE_LC_EXT)))
+      c = c - 'A' + 'a';
+#endif
+    pattern[i] = c;
+  }
+
+  return true;
+}
+
 const char * GemPattern::parseAtari(const char *path) {
   int i = 0; // Index in the source string
   int j = 0; // Index in name
@@ -416,6 +493,42 @@ int GemPattern::getNextUnicode(const char *sourceStr, char *target) {
   return -l;
 }
 
+GemPatternMatcher::GemPatternMatcher(const GemPattern &pattern) {
+  uint8_t v[12];
+  uint8_t m[12];
+  for(int i = 0; i < 11; ++i) {
+    char c = pattern.pattern[i];
+#if ! ACSI_GEMDRIVE_UPPER_CASE
+    if(c >= 'a' && c <= 'z')
+      c = c - 'a' + 'A';
+#endif
+    v[i] = c == '?' ? 0 : c;
+    m[i] = c == '?' ? 0 : 0xff;
+  }
+  v[11] = 0;
+  m[11] = 0;
+  memcpy(value, v, sizeof(value));
+  memcpy(mask, m, sizeof(mask));
+}
+
+bool GemPatternMatcher::matches(const GemPattern &name) const {
+  uint32_t n[3];
+  n[2] = 0;
+  memcpy(n, name.pattern, 11);
+#if ! ACSI_GEMDRIVE_UPPER_CASE
+  // Case insensitive compare
+  uint8_t *c = (uint8_t *)n;
+  for(int i = 0; i < 11; ++i)
+    if(c[i] >= 'a' && c[i] <= 'z')
+      c[i] = c[i] - 'a' + 'A';
+#endif
+
+  // '.' and '..' need no special treatment: they are padded with spaces
+  return !(((n[0] ^ value[0]) & mask[0])
+         | ((n[1] ^ value[1]) & mask[1])
+         | ((n[2] ^ value[2]) & mask[2]));
+}
+
 int GemPattern::toUnicode(char *target, int bufSize) const {
   int chars = 0;
 
@@ -626,6 +739,11 @@ bool GemPath::parent() {
   for(i = 1; i < maxDepth && indexes[i]; ++i);
   indexes[i - 1] = 0;
 
+#if ACSI_GEMDRIVE_PATH_CACHE
+  if(loadCache())
+    return true;
+#endif
+
   // Traverse from root to open the parent
   close();
   FsFile f[2];
@@ -644,6 +762,10 @@ bool GemPath::parent() {
   }
   *(FsFile*)this = f[i & 1];
 
+#if ACSI_GEMDRIVE_PATH_CACHE
+  storeCache();
+#endif
+
   return true;
 }
 
@@ -676,6 +798,22 @@ bool GemPath::openPath(const char *path, GemPattern &last, bool parseLastName) {
     clear();
   }
 
+#if ACSI_GEMDRIVE_PATH_CACHE
+  // Look up the directory part of the path in the cache
+  const char *dirStart = path;
+  const char *dirEnd = strrchr(path, '\\');
+  uint32_t startCluster = TinyFile::getCluster(*this);
+  uint32_t pathKey = 0;
+  if(dirEnd) {
+    ++dirEnd;
+    pathKey = hashPath(startCluster, path, dirEnd);
+    if(pathKey && loadCache(pathKey, path, dirEnd)) {
+      path = dirEnd;
+      pathKey = 0;
+    }
+  }
+#endif
+
   for(;;) {
     path = last.parseAtari(path);
     if(!parseLastName && !*path)
@@ -705,6 +843,13 @@ bool GemPath::openPath(const char *path, GemPattern &last, bool parseLastName) {
       append(child);
     }
 
+#if ACSI_GEMDRIVE_PATH_CACHE
+    if(pathKey && path == dirEnd) {
+      storeCache(pathKey, startCluster, dirStart, dirEnd);
+      pathKey = 0;
+    }
+#endif
+
     if(parseLastName && !*path)
       return true;
   }
@@ -715,6 +860,11 @@ bool GemPath::openFile(const GemPattern &name, FsFile &file, oflag_t oflag) {
     // Disk swapped
     return false;
 
+#if ACSI_GEMDRIVE_DIR_INDEXES
+  if(name.isFileName())
+    return openIndexed(name, file, oflag);
+#endif
+
   rewind();
   for(;;) {
     file.openNext(this, O_RDONLY);
@@ -732,6 +882,222 @@ bool GemPath::openFile(const GemPattern &name, FsFile &file, oflag_t oflag) {
   }
 }
 
+bool GemPath::openIndexed(const GemPattern &name, FsFile &file, oflag_t oflag) {
+#if ACSI_GEMDRIVE_DIR_INDEXES
+  GemDirIndex &index = GemDirIndex::get(mediaId, TinyFile::getCluster(*this));
+  uint16_t hash = GemDirIndex::hash(name);
+
+  uint16_t found = index.find(*this, name, hash);
+  if(found)
+    return file.open(this, found - 1, oflag);
+
+  if(index.complete)
+    return false;
+
+  // Scan the rest of the directory, indexing names on the way
+  if(!seekSet(index.position))
+    return false;
+
+  bool indexing = true;
+  for(;;) {
+    file.openNext(this, O_RDONLY);
+    if(!file) {
+      if(indexing)
+        index.complete = true;
+      return false;
+    }
+
+    GemPattern fileName;
+    bool visible = fileName.parseFileName(file);
+    if(indexing && visible)
+      indexing = index.insert(GemDirIndex::hash(fileName), file.dirIndex());
+    if(indexing)
+      index.position = curPosition();
+
+    if(visible && name == fileName) {
+      if(oflag == O_RDONLY)
+        return true;
+
+      // Reopen with the correct flags
+      auto dirIndex = file.dirIndex();
+      return file.open(this, dirIndex, oflag);
+    }
+  }
+#else
+  return false;
+#endif
+}
+
+#if ACSI_GEMDRIVE_DIR_INDEXES
+GemDirIndex & GemDirIndex::get(uint32_t mediaId, uint32_t dirCluster) {
+  GemDirIndex *oldest = &indexes[0];
+  uint32_t now = millis();
+
+  for(int i = 0; i < indexesMax; ++i) {
+    GemDirIndex &index = indexes[i];
+    if(index.mediaId == mediaId && index.dirCluster == dirCluster) {
+      index.lastUse = now;
+      return index;
+    }
+    if(!index.mediaId
+        || (oldest->mediaId && now - index.lastUse > now - oldest->lastUse))
+      oldest = &index;
+  }
+
+  oldest->clear();
+  oldest->mediaId = mediaId;
+  oldest->dirCluster = dirCluster;
+  oldest->lastUse = now;
+  return *oldest;
+}
+
+void GemDirIndex::invalidate() {
+  for(int i = 0; i < indexesMax; ++i)
+    indexes[i].mediaId = 0;
+}
+
+uint16_t GemDirIndex::hash(const GemPattern &name) {
+  uint16_t h = 5381;
+  for(int i = 0; i < 11; ++i) {
+    char c = name.pattern[i];
+#if ! ACSI_GEMDRIVE_UPPER_CASE
+    // Names are case insensitive
+    if(c >= 'a' && c <= 'z')
+      c = c - 'a' + 'A';
+#endif
+    h = (h * 33) ^ (uint8_t)c;
+  }
+  return h;
+}
+
+uint16_t GemDirIndex::find(FsFile &dir, const GemPattern &name, uint16_t hash) {
+  uint16_t found = 0;
+  FsFile file;
+
+  // Check all candidates: duplicate 8.3 names are possible and the first one
+  // in directory order must win
+  for(int slot = hash & (size - 1); entries[slot].index; slot = (slot + 1) & (size - 1)) {
+    const Entry &entry = entries[slot];
+    if(entry.hash != hash || (found && entry.index > found))
+      continue;
+    if(file.open(&dir, entry.index - 1, O_RDONLY) && name == file)
+      found = entry.index;
+    file.close();
+  }
+
+  return found;
+}
+
+bool GemDirIndex::insert(uint16_t hash, uint16_t dirIndex) {
+  // Keep free slots to terminate searches quickly
+  if(count >= size * 3 / 4)
+    return false;
+
+  int slot = hash & (size - 1);
+  while(entries[slot].index)
+    slot = (slot + 1) & (size - 1);
+
+  entries[slot].hash = hash;
+  entries[slot].index = dirIndex + 1;
+  ++count;
+
+  return true;
+}
+
+void GemDirIndex::clear() {
+  memset(entries, 0, sizeof(entries));
+  count = 0;
+  position = 0;
+  complete = false;
+}
+#endif
+
+#if ACSI_GEMDRIVE_LISTINGS
+const GemDirListing::Entry * GemDirListing::next(const TinyFile &file, FsVolume &volume) {
+  GemDirListing *page = nullptr;
+
+  for(int i = 0; i < listingsMax; ++i) {
+    GemDirListing &listing = listings[i];
+    if(!listing.mediaId
+        || listing.mediaId != file.mediaId
+        || listing.dirCluster != file.dirCluster)
+      continue;
+
+    // Find the position of file in the page
+    int p = -1;
+    if(listing.startIndex == file.index) {
+      p = 0;
+    } else {
+      for(int e = 0; e < listing.count; ++e)
+        if(listing.entries[e].index == file.index) {
+          p = e + 1;
+          break;
+        }
+    }
+    if(p < 0)
+      continue;
+
+    if(p < listing.count)
+      return &listing.entries[p];
+    if(listing.complete)
+      return nullptr;
+
+    // End of the page: continue the listing in the same page
+    page = &listing;
+    break;
+  }
+
+  if(!page) {
+    page = &listings[nextFill];
+    nextFill = (nextFill + 1) % listingsMax;
+  }
+
+  page->fill(file, volume);
+  if(!page->count)
+    return nullptr;
+  return &page->entries[0];
+}
+
+void GemDirListing::invalidate() {
+  for(int i = 0; i < listingsMax; ++i)
+    listings[i].mediaId = 0;
+}
+
+void GemDirListing::fill(const TinyFile &file, FsVolume &volume) {
+  mediaId = file.mediaId;
+  dirCluster = file.dirCluster;
+  startIndex = file.index;
+  count = 0;
+  complete = false;
+
+  // Open the parent once, then walk through the directory
+  TinyFile cursor = file;
+  FsFile &f = cursor.openNext(volume);
+  for(;;) {
+    if(!f) {
+      complete = true;
+      return;
+    }
+
+    Entry &entry = entries[count];
+    if(entry.name.parseFileName(f)) {
+      entry.attrib = f.isDir() ? 0x10 : f.attrib();
+      uint16_t date;
+      uint16_t time;
+      f.getModifyDateTime(&date, &time);
+      entry.date = date;
+      entry.time = time;
+      entry.length = (uint32_t)f.fileSize();
+      entry.index = f.dirIndex() + 1;
+      if(++count == size)
+        return;
+    }
+
+    f.openNext(&TinyFile::lastParent);
+  }
+}
+#endif
+
 int GemPath::toAtari(char *out, int bufSize) const {
   if(isRoot()) {
     out[0] = '\\';
@@ -745,6 +1111,17 @@ int GemPath::toAtari(char *out, int bufSize) const {
     return -1;
   }
 
+#if ACSI_GEMDRIVE_PATH_CACHE
+  uint32_t cluster = TinyFile::getCluster(const_cast<GemPath &>(*this));
+  if(atariMediaId == mediaId && atariCluster == cluster) {
+    int len = strlen(atariPath);
+    if(len < bufSize) {
+      strcpy(out, atariPath);
+      return len;
+    }
+  }
+#endif
+
   FsFile f[2];
   f[0].openRoot(&sd.fs);
   f[1].openRoot(&sd.fs);
@@ -785,6 +1162,15 @@ int GemPath::toAtari(char *out, int bufSize) const {
   }
 
   out[len] = 0;
+
+#if ACSI_GEMDRIVE_PATH_CACHE
+  if(len < (int)sizeof(atariPath)) {
+    strcpy(atariPath, out);
+    atariMediaId = mediaId;
+    atariCluster = cluster;
+  }
+#endif
+
   return len;
 }
 
@@ -843,6 +1229,116 @@ int GemPath::toUnicode(char *out, int bufSize) const {
   return len;
 }
 
+void GemPath::invalidateCache() {
+#if ACSI_GEMDRIVE_PATH_CACHE
+  for(int i = 0; i < ACSI_GEMDRIVE_PATH_CACHE; ++i)
+    cache[i].forget();
+  atariMediaId = 0;
+#endif
+}
+
+#if ACSI_GEMDRIVE_PATH_CACHE
+uint32_t GemPath::hashPath(uint32_t startCluster, const char *path, const char *end) {
+  if(end - path > CacheEntry::pathMax)
+    return 0;
+
+  // FNV-1a of the start directory and the path string
+  uint32_t h = 2166136261u ^ startCluster;
+  for(; path < end; ++path) {
+    char c = *path;
+    // Names are case insensitive
+    if(c >= 'a' && c <= 'z')
+      c = c - 'a' + 'A';
+    h = (h ^ (uint8_t)c) * 16777619u;
+  }
+
+  // 0 means no key
+  return h ? h : 1;
+}
+
+bool GemPath::CacheEntry::matches(uint32_t startCluster_, const char *path_, const char *end) const {
+  int len = end - path_;
+  // The hash only speeds up the search, the string must match
+  return startCluster == startCluster_
+    && !strncasecmp(path, path_, len)
+    && (len == pathMax || !path[len]);
+}
+
+bool GemPath::loadCache(uint32_t pathKey, const char *path, const char *end) {
+  uint32_t startCluster = path ? TinyFile::getCluster(*this) : 0;
+
+  for(int i = 0; i < ACSI_GEMDRIVE_PATH_CACHE; ++i) {
+    CacheEntry &entry = cache[i];
+    if(!entry.mediaId || entry.mediaId != mediaId)
+      continue;
+
+    if(path) {
+      if(entry.pathKey != pathKey || !entry.matches(startCluster, path, end))
+        continue;
+    } else {
+      // Search by indexes
+      int j;
+      for(j = 0; j < maxDepth && indexes[j] && entry.indexes[j] == indexes[j]; ++j);
+      if(j < maxDepth && (indexes[j] || entry.indexes[j]))
+        continue;
+    }
+
+    entry.lastUse = millis();
+    for(int j = 0; j < maxDepth; ++j) {
+      indexes[j] = entry.indexes[j];
+      if(!indexes[j])
+        break;
+    }
+    close();
+    *(FsFile *)this = entry.dir;
+    return true;
+  }
+
+  return false;
+}
+
+void GemPath::storeCache(uint32_t pathKey, uint32_t startCluster, const char *path, const char *end) {
+  CacheEntry *target = &cache[0];
+  uint32_t now = millis();
+
+  for(int i = 0; i < ACSI_GEMDRIVE_PATH_CACHE; ++i) {
+    CacheEntry &entry = cache[i];
+    if(!entry.mediaId) {
+      if(target->mediaId)
+        target = &entry;
+      continue;
+    }
+    if(target->mediaId && now - entry.lastUse > now - target->lastUse)
+      target = &entry;
+  }
+
+  // Replace the entry without syncing the volume
+  target->forget();
+  target->dir = *this;
+
+  int len = path ? end - path : 0;
+  if(len)
+    memcpy(target->path, path, len);
+  if(len < CacheEntry::pathMax)
+    target->path[len] = 0;
+  target->startCluster = startCluster;
+
+  for(int j = 0; j < maxDepth; ++j) {
+    target->indexes[j] = indexes[j];
+    if(!indexes[j])
+      break;
+  }
+  target->pathKey = pathKey;
+  target->mediaId = mediaId;
+  target->lastUse = now;
+}
+
+GemPath::CacheEntry GemPath::cache[ACSI_GEMDRIVE_PATH_CACHE];
+uint32_t GemPath::atariMediaId;
+uint32_t GemPath::atariCluster;
+char GemPath::atariPath[128];
+#endif
+
 bool GemPath::isContainedBy(FsFile &file) const {
   if(file.isDir() && !file.isSubDir())
     return true;
@@ -875,6 +1371,36 @@ void GemFile::set(GemPath &parent, FsFile &file, oflag_t oflag_, Long basePage_)
   position = 0;
   basePage = basePage_;
   oflag = oflag_;
+  archive = false;
+  preallocated = 0;
+  writeError = false;
+}
+
+bool GemFile::close() {
+  bool success = true;
+
+  if(archive && checkMedium()) {
+    archive = false;
+    FsFile &file = reopen();
+    success = file && file.attrib(file.attrib() | 0x20);
+  }
+
+  if(preallocated && checkMedium()) {
+    // Release clusters reserved after the end of file
+    FsFile &file = reopen();
+    if(file) {
+      uint64_t allocated = allocatedSize(file);
+      if(file.truncate(file.fileSize()))
+        updateFree(allocated, file.fileSize());
+      else
+        success = false;
+    } else {
+      success = false;
+    }
+    preallocated = 0;
+  }
+
+  return TinyFile::close() && success;
 }
 
 FsFile & GemFile::reopen() {
@@ -903,13 +1429,18 @@ int32_t GemFile::read(uint8_t *data, int32_t size) {
 }
 
 int32_t GemFile::write(uint8_t *data, int32_t size) {
+  preallocate(size);
+
   FsFile &file = reopen();
   if(!file)
     return -1;
 
+  uint64_t allocated = allocatedSize(file);
   int w = file.write(data, size);
   position = file.curPosition();
 
+  updateFree(allocated, allocatedSize(file));
+
   return w;
 }
 
@@ -939,6 +1470,58 @@ int32_t GemFile::seek(int32_t offset, int whence) {
   return position;
 }
 
+#if ACSI_GEMDRIVE_FILE_BUFFERS
+bool GemFileBuffer::flush() {
+  if(fd < 0)
+    return true;
+
+  GemFile &file = GemDrive::files[fd];
+  fd = -1;
+
+  if(!dirty)
+    return true;
+
+  // Write buffered data at its position, then restore the file position
+  uint32_t position = file.position;
+  file.position = offset;
+  bool success = file.write(data, size) == size;
+  file.position = position;
+
+  return success;
+}
+#endif
+
+void GemFile::preallocate(uint32_t size) {
+#if ACSI_GEMDRIVE_PREALLOCATE
+  if(position || preallocated)
+    return;
+
+  FsFile &file = reopen();
+  if(!file || file.fileSize())
+    return;
+
+  if(size < ACSI_GEMDRIVE_PREALLOCATE)
+    size = ACSI_GEMDRIVE_PREALLOCATE;
+
+  // Fails if there is no contiguous free space: clusters will be allocated
+  // one by one when writing.
+  if(!file.preAllocate(size)) {
+    Monitor::dbg("prealloc failed ");
+    return;
+  }
+
+  Monitor::dbg("prealloc=", size, ' ');
+  preallocated = size;
+  updateFree(0, size);
+#endif
+}
+
+void GemFile::updateFree(uint64_t sizeBefore, uint64_t sizeAfter) const {
+  GemDrive *drive = GemDrive::getDrive(mediaId, BlockDev::CACHED);
+  if(drive)
+    drive->updateFree(sizeBefore, sizeAfter);
+}
+
 bool GemFile::checkMedium() const {
   return GemDrive::getDrive(mediaId);
 }
@@ -947,7 +1530,7 @@ bool GemFile::isWritable() const {
   return oflag & O_RDWR;
 }
 
-GemDrive::GemDrive(SdDev &sd_): sd(sd_), curPath(sd_) {}
+GemDrive::GemDrive(SdDev &sd_): sd(sd_), curPath(sd_), freeMediaId(0) {}
 
 void GemDrive::process(uint8_t cmd) {
   switch(cmd) {
@@ -1002,9 +1585,20 @@ void GemDrive::process(uint8_t cmd) {
       break;
 #endif
 
+#if ! ACSI_PIO
+    case 0x0d:
+      // GEMDOS system call hook, the current process changed
+      dbg("GEMDOS* ");
+      processChanged();
+      onGemdos();
+      break;
+#endif
+
     case 0x0e:
       // GEMDOS system call hook
       dbg("GEMDOS ");
+      if(!trackProcess)
+        processChanged();
       onGemdos();
       break;
 
@@ -1028,6 +1622,15 @@ void GemDrive::process(uint8_t cmd) {
       DmaPort::waitCommand();
       // The ST is now waiting for commands
 
+#if ! ACSI_PIO
+      {
+        // The DMA pointer is on the driver extension variables, if any
+        GemDriverVars vars;
+        DmaPort::readDma((uint8_t *)&vars, 8);
+        driverVars = vars.magic == ToLong('A', '2', 'E', 'X') ? (uint32_t)vars.self : 0;
+      }
+#endif
+
       // Do initialization process
       dbg(" Init ");
       onInit();
@@ -1081,7 +1684,7 @@ void GemDrive::onBoot() {
     // EmuTOS found. Load and run it.
     FsFile emutos = fs.open(ACSI_GEMDRIVE_LOAD_EMUTOS);
     uint32_t basepage;
-    uint32_t result = loadPrg(emutos, ToLong(0), ToLong(0), basepage);
+    uint32_t result = Devices::drives[Devices::gemBootDrive].loadPrg(emutos, ToLong(0), ToLong(0), basepage);
     dbgHex(basepage," ");
     if(result == E_OK) {
       dbg("successful\n");
@@ -1093,7 +1696,9 @@ void GemDrive::onBoot() {
 #endif
 
   // Prepare the driver binary
-  memcpy(buf, GEMDRIVE_boot_bin, GEMDRIVE_boot_bin_len);
+  // The boot sector is too small for driver extensions: upload the full
+  // driver instead.
+  memcpy(buf, GEMDRIVE_drv_bin, GEMDRIVE_drv_bin_len);
 
   // Patch ACSI id
   buf[GEMDRIVE_boot_acsiid] |= (Devices::gemBootDrive + Devices::acsiFirstId) << 5;
@@ -1103,10 +1708,18 @@ void GemDrive::onBoot() {
 
   // Upload the driver to resident memory
 
-  uint32_t driverSize = (GEMDRIVE_boot_bin_len + 0xf) & 0xfffffff0;
+  uint32_t driverSize = (GEMDRIVE_drv_bin_len + 0xf) & 0xfffffff0;
   ToLong driverMem = Malloc(driverSize);
 
-  sendAt(driverMem, buf, GEMDRIVE_boot_bin_len);
+  sendAt(driverMem, buf, GEMDRIVE_drv_bin_len);
+
+#if ! ACSI_PIO
+  // Locate driver extension variables
+  driverVars = 0;
+  for(unsigned int i = 0; i < GEMDRIVE_drv_bin_len - sizeof(GemDriverVars); i += 2)
+    if(*(const Long *)(&GEMDRIVE_drv_bin[i]) == ToLong('A', '2', 'E', 'X'))
+      driverVars = driverMem + i;
+#endif
 
   // Install system call hooks
   // Warning: installed system calls must be the same as in asm/GEMDRIVE/gem.s
@@ -1118,6 +1731,13 @@ void GemDrive::onBoot() {
 void GemDrive::onInit(bool setBootDrive) {
   int d;
 
+  trackProcess = false;
+  processChanged();
+  setDriverExt(false);
+#if ACSI_GEMDRIVE_BOOT_RECORD
+  bootRecordDrive = nullptr;
+#endif
+
   // Driver splash screen
   tosPrint("\eE", "ACSI2STM " ACSI2STM_VERSION " by Jean-Matthieu Coulon", "\r\n",
            "GPLv3 license. Source & doc at", "\r\n",
@@ -1156,6 +1776,11 @@ void GemDrive::onInit(bool setBootDrive) {
     p_run = readLongAt(os_beg + offsetof(OSHEADER, p_run));
   }
 
+#if ACSI_SD_LAZY_INIT
+  // Drive letters depend on the mode of all slots
+  Devices::lazyInit(true);
+#endif
+
   // Unmount all drives and initialize SD cards
   for(d = 0; d < driveCount; ++d) {
     Devices::drives[d].id = -1;
@@ -1215,6 +1840,10 @@ void GemDrive::onInit(bool setBootDrive) {
   }
   _drvbits(drvbits);
 
+#if ! ACSI_PIO
+  initDriverExt();
+#endif
+
   // Set boot drive on the ST
   if(setBootDrive) {
     for(d = 0; d < driveCount; ++d) {
@@ -1223,6 +1852,9 @@ void GemDrive::onInit(bool setBootDrive) {
         setCurDrive(Devices::drives[d].id);
         _bootdev(Devices::drives[d].id);
         Dsetdrv(Devices::drives[d].id);
+#if ACSI_GEMDRIVE_BOOT_RECORD
+        loadBootRecord(&Devices::drives[d]);
+#endif
         memcpy(buf, "\r\nBoot on ?:\r\n\n", 17);
         buf[10] = Devices::drives[d].letter();
         tosPrint((const char *)buf);
@@ -1246,6 +1878,11 @@ void GemDrive::onInit(bool setBootDrive) {
 
   // Continue boot sequence
   forward();
+
+#if ! ACSI_PIO
+  // Next calls run on the resident driver
+  setDriverExt(driverVars, driverBounce, driverBounceSize);
+#endif
 }
 
 void GemDrive::onGemdos() {
@@ -1262,6 +1899,7 @@ void GemDrive::onGemdos() {
   DECLARE_CALLBACK(Pterm0);
   DECLARE_CALLBACK(Cconws);
   DECLARE_CALLBACK(Dsetdrv);
+  DECLARE_CALLBACK(Fsetdta);
   DECLARE_CALLBACK(Tgetdate);
   DECLARE_CALLBACK(Tsetdate);
   DECLARE_CALLBACK(Tgettime);
@@ -1285,6 +1923,15 @@ void GemDrive::onGemdos() {
   DECLARE_CALLBACK(Fsfirst);
   DECLARE_CALLBACK(Frename);
   DECLARE_CALLBACK(Fdatime);
+  DECLARE_CALLBACK(Fcopy);
+  DECLARE_CALLBACK(Fxattr);
+#if ACSI_GEMDRIVE_MAX_DIRS
+  DECLARE_CALLBACK(Dopendir);
+  DECLARE_CALLBACK(Dreaddir);
+  DECLARE_CALLBACK(Dxreaddir);
+  DECLARE_CALLBACK(Drewinddir);
+  DECLARE_CALLBACK(Dclosedir);
+#endif
 
   // Just log these callbacks
 #if ACSI_DEBUG
@@ -1316,7 +1963,6 @@ void GemDrive::onGemdos() {
   DECLARE_CALLBACK(Cauxis);
   DECLARE_CALLBACK(Cauxos);
   DECLARE_CALLBACK(Dgetdrv);
-  DECLARE_CALLBACK(Fsetdta);
   DECLARE_CALLBACK(Super);
   DECLARE_CALLBACK(Malloc);
   DECLARE_CALLBACK(Mfree);
@@ -1332,9 +1978,49 @@ void GemDrive::onGemdos() {
   forward();
 }
 
-bool GemDrive::onPterm0(const Tos::Pterm0_p &) {
-  closeProcessFiles();
-  return forward();
+void GemDrive::onIdle() {
+#if ACSI_GEMDRIVE_FILE_BUFFERS
+  // Write one idle buffer at a time to keep the bus responsive
+  for(int b = 0; b < fileBuffersMax; ++b) {
+    GemFileBuffer &buffer = fileBuffers[b];
+    if(buffer && buffer.dirty && millis() - buffer.lastUse >= ACSI_GEMDRIVE_FILE_BUFFER_DELAY) {
+      // Nobody waits for this write: report failures on the next call
+      GemFile &file = files[buffer.fd];
+      if(!buffer.flush())
+        file.writeError = true;
+      return;
+    }
+  }
+#endif
+
+  // Write file sizes and dates after a while
+  if(TinyFile::isDirty()
+      && millis() - TinyFile::dirtyTime >= ACSI_GEMDRIVE_FILE_BUFFER_DELAY) {
+    TinyFile::syncDirty();
+    return;
+  }
+
+#if ACSI_GEMDRIVE_BOOT_RECORD
+  if(bootRecordDrive) {
+    if(millis() - bootRecordStart >= ACSI_GEMDRIVE_BOOT_RECORD_TIME) {
+      saveBootRecord();
+      return;
+    }
+    if(replayBootPath())
+      return;
+  }
+#endif
+
+  // Count free clusters in the background, one sector at a time
+  for(int i = 0; i < driveCount; ++i)
+    if(!Devices::drives[i].scanFree())
+      return;
+}
+
+bool GemDrive::onPterm0(const Tos::Pterm0_p &) {
+  closeProcessFiles();
+  processChanged();
+  return forward();
 }
 
 bool GemDrive::onCconws(const Tos::Cconws_p &p) {
@@ -1347,6 +2033,13 @@ bool GemDrive::onCconws(const Tos::Cconws_p &p) {
   return forward();
 }
 
+bool GemDrive::onFsetdta(const Tos::Fsetdta_p &p) {
+  // Track the DTA of the current process
+  shadowDta = p.buf;
+  shadowDtaValid = true;
+  return forward();
+}
+
 bool GemDrive::onDsetdrv(const Tos::Dsetdrv_p &p) {
   // Track current drive
   setCurDrive(p.drv);
@@ -1416,7 +2109,7 @@ bool GemDrive::onDfree(const Tos::Dfree_p &p) {
 
   uint32_t clsiz = volume.sectorsPerCluster();
   uint32_t total = volume.clusterCount();
-  uint32_t free = volume.freeClusterCount();
+  uint32_t free = drive->freeClusterCount();
 
   // Unsurprisingly, the ST can't really handle gigabytes, so we have to cap
   // these values. As long as there is more free space than what a ST operating
@@ -1480,9 +2173,16 @@ bool GemDrive::onDcreate(const Tos::Dcreate_p &p) {
   if(!name || name.isCurDir() || name.isParentDir())
     return rte(EPTHNF);
 
+#if ACSI_GEMDRIVE_DIR_INDEXES
+  GemDirIndex::invalidate();
+#endif
+  invalidateListings();
   if(!drive->sd.fs.mkdir(unicodeName, false))
     return rte(EACCDN);
 
+  // Growth of the parent directory is not accounted for
+  drive->adjustFree(-1);
+
   return rte(E_OK);
 }
 
@@ -1510,9 +2210,17 @@ bool GemDrive::onDdelete(const Tos::Ddelete_p &p) {
     return rte(EPTHNF);
 
   dbg("-> ", unicodeName, ' ');
+#if ACSI_GEMDRIVE_DIR_INDEXES
+  GemDirIndex::invalidate();
+#endif
+  invalidateListings();
+  GemPath::invalidateCache();
   if(!drive->sd.fs.rmdir(unicodeName))
     return rte(EACCDN);
 
+  // The directory may span multiple clusters: count again
+  drive->invalidateFree();
+
   return rte(E_OK);
 }
 
@@ -1574,13 +2282,27 @@ bool GemDrive::onFcreate(const Tos::Fcreate_p &p) {
     return rte(EACCDN);
 
   FsFile newFile;
-  if(!parent.openFile(name, newFile, O_TRUNC | O_RDWR)) {
+  if(parent.openFile(name, newFile, O_RDWR)) {
+    // Truncate the existing file
+    invalidateListings();
+#if ! ACSI_PIO
+    dropReadCache();
+#endif
+    uint64_t size = newFile.fileSize();
+    if(!newFile.truncate(0))
+      return rte(EACCDN);
+    drive->updateFree(size, 0);
+  } else {
     const char *unicodeName = toUnicode(parent, name);
     if(!unicodeName)
       // Incompatible character
       return rte(EPTHNF);
 
     dbg("-> ", unicodeName, ' ');
+#if ACSI_GEMDRIVE_DIR_INDEXES
+    GemDirIndex::invalidate();
+#endif
+    invalidateListings();
     newFile = drive->sd.fs.open(unicodeName, O_CREAT | O_TRUNC | O_RDWR);
     if(!newFile || newFile.isDir())
       return rte(EACCDN);
@@ -1625,14 +2347,14 @@ bool GemDrive::onFopen(const Tos::Fopen_p &p) {
   if(file.isDir())
     return rte(EFILNF);
 
-  if(oflag & O_RDWR)
-    // Set the archive flag
-    file.attrib(file.attrib() | 0x20);
-
   Word fd = drive->createFd(parent, file, oflag);
   if(!fd)
     return rte(ENHNDL);
 
+  if(oflag & O_RDWR)
+    // Set the archive flag when closing the file
+    files[fd.bytes[1]].archive = true;
+
   return rte(ToLong(0, 0, fd.bytes[0], fd.bytes[1]));
 }
 
@@ -1647,7 +2369,10 @@ bool GemDrive::onFclose(const Tos::Fclose_p &p) {
   if(!file)
     return rte(EIHNDL);
 
-  file.close();
+  bool writeError = file.writeError;
+  if(!closeFd(p.handle.bytes[1]) || writeError)
+    return rte(EWRITF);
+
   return rte(E_OK);
 }
 
@@ -1662,6 +2387,13 @@ bool GemDrive::onFread(const Tos::Fread_p &p) {
   if(!file.checkMedium())
     return rte(EACCDN);
 
+  if(!flushFd(p.handle.bytes[1]) || !syncFile(p.handle.bytes[1], false))
+    return rte(EWRITF);
+
+#if ! ACSI_PIO
+  dropReadCache(p.handle.bytes[1]);
+#endif
+
   int done = 0;
   int bufSize;
   uint32_t ptr = p.buf;
@@ -1670,6 +2402,22 @@ bool GemDrive::onFread(const Tos::Fread_p &p) {
   if(size < 0)
     return rte(ERANGE);
 
+#if ! ACSI_PIO
+  // Small reads will be served by the ST
+  bool cache = readCacheBuf && size <= readCacheSize / 4;
+  if(cache)
+    ++readCacheMisses;
+#endif
+
+#if ACSI_GEMDRIVE_FILE_BUFFERS
+  // Small reads are served from the read-ahead window
+  if(size && size < GemFileBuffer::bufSize) {
+    done = bufferRead(p.handle.bytes[1], ptr, size);
+    ptr += done;
+    size -= done;
+  }
+#endif
+
   while(size > 0) {
     if(size > (int)sizeof(buf))
       bufSize = sizeof(buf);
@@ -1693,6 +2441,11 @@ bool GemDrive::onFread(const Tos::Fread_p &p) {
     }
   }
 
+#if ! ACSI_PIO
+  if(cache && !size)
+    fillReadCache(p.handle.bytes[1]);
+#endif
+
   return rte(ToLong(done));
 }
 
@@ -1707,6 +2460,19 @@ bool GemDrive::onFwrite(const Tos::Fwrite_p &p) {
   if(!file.isWritable() || !file.checkMedium())
     return rte(EACCDN);
 
+  // Buffered data from a previous call was lost
+  if(file.writeError) {
+    file.writeError = false;
+    return rte(EWRITF);
+  }
+
+  // File size changes
+  invalidateListings();
+#if ! ACSI_PIO
+  // Data changes
+  dropReadCache();
+#endif
+
   int done = 0;
   int bufSize;
   uint32_t ptr = p.buf;
@@ -1715,6 +2481,22 @@ bool GemDrive::onFwrite(const Tos::Fwrite_p &p) {
   if(size < 0)
     return rte(ERANGE);
 
+  // Other descriptors on this file must not keep stale or pending data
+  if(!syncFile(p.handle.bytes[1], true))
+    return rte(EWRITF);
+
+#if ACSI_GEMDRIVE_FILE_BUFFERS
+  // Small writes are stored in a RAM buffer
+  if(size && size < GemFileBuffer::bufSize && bufferWrite(p.handle.bytes[1], ptr, size))
+    return rte(ToLong(size));
+#endif
+
+  if(!flushFd(p.handle.bytes[1], true))
+    return rte(EWRITF);
+
+  // Reserve space for the whole write at once
+  file.preallocate(size);
+
   while(size > 0) {
     if(size > (int)sizeof(buf))
       bufSize = sizeof(buf);
@@ -1769,9 +2551,16 @@ bool GemDrive::onFdelete(const Tos::Fdelete_p &p) {
   if(!drive->sd.fs.exists(unicodeName))
     return rte(EFILNF);
 
+  uint64_t size = file.fileSize();
+#if ACSI_GEMDRIVE_DIR_INDEXES
+  GemDirIndex::invalidate();
+#endif
+  invalidateListings();
   if(!drive->sd.fs.remove(unicodeName))
     return rte(EACCDN);
 
+  drive->updateFree(size, 0);
+
   return rte(E_OK);
 }
 
@@ -1786,6 +2575,13 @@ bool GemDrive::onFseek(const Tos::Fseek_p &p) {
   if(!file.checkMedium())
     return rte(EACCDN);
 
+  if(!flushFd(p.handle.bytes[1]) || !syncFile(p.handle.bytes[1], false))
+    return rte(EWRITF);
+
+#if ! ACSI_PIO
+  dropReadCache(p.handle.bytes[1]);
+#endif
+
   int32_t r = file.seek(p.offset, p.seekmode.bytes[1]);
 
   if(r < 0)
@@ -1814,9 +2610,11 @@ bool GemDrive::onFattrib(const Tos::Fattrib_p &p) {
   if(!file || file.isDir())
     return rte(EFILNF);
 
-  if(p.wflag.bytes[1])
+  if(p.wflag.bytes[1]) {
+    invalidateListings();
     if(!file.attrib(p.attrib.bytes[1]))
       return rte(EACCDN);
+  }
 
   return rte(ToLong(0, 0, 0, file.attrib()));
 }
@@ -1843,6 +2641,9 @@ bool GemDrive::onDgetpath(const Tos::Dgetpath_p &p) {
 }
 
 bool GemDrive::onPexec(const Tos::Pexec_p &p) {
+  // A child process may start
+  processChanged();
+
   if(p.mode != 0 && p.mode != 3)
     return forward();
 
@@ -1869,7 +2670,7 @@ bool GemDrive::onPexec(const Tos::Pexec_p &p) {
     return rte(EFILNF);
 
   uint32_t basepage;
-  uint32_t result = loadPrg(prgFile, p0.cmdline, p0.env, basepage);
+  uint32_t result = drive->loadPrg(prgFile, p0.cmdline, p0.env, basepage);
   if(result != E_OK)
     return rte(result);
 
@@ -1886,6 +2687,7 @@ bool GemDrive::onPexec(const Tos::Pexec_p &p) {
 
 bool GemDrive::onPterm(const Tos::Pterm_p &) {
   closeProcessFiles();
+  processChanged();
   return forward();
 }
 
@@ -1909,18 +2711,24 @@ bool GemDrive::onFsfirst(const Tos::Fsfirst_p &p) {
   dta.file.set(parent.mediaId, parent);
   dta.attribMask = p.attr;
 
+  // Make sure that file sizes are up to date
+  flushAll();
+
   // Scan the first file
   return drive->scanDTA(dta, EFILNF);
 }
 
 bool GemDrive::onFsnext(const Tos::Fsnext_p &) {
   GemDriveDTA dta;
-  readAt(dta, Fgetdta());
+  readAt(dta, getDta());
 
   GemDrive *drive = getDrive(dta.file.mediaId, BlockDev::CACHED);
   if(!drive)
     return forward();
 
+  // Make sure that file sizes are up to date
+  flushAll();
+
   return drive->scanDTA(dta);
 }
 
@@ -1990,6 +2798,11 @@ bool GemDrive::onFrename(const Tos::Frename_p &p) {
   dbg(" to -> ", unicodeName, ' ');
   if(toDrive->sd.fs.exists(unicodeName))
     return rte(EACCDN);
+#if ACSI_GEMDRIVE_DIR_INDEXES
+  GemDirIndex::invalidate();
+#endif
+  invalidateListings();
+  GemPath::invalidateCache();
   if(!from.rename(unicodeName))
     return rte(EACCDN);
 
@@ -2000,10 +2813,18 @@ bool GemDrive::onFdatime(const Tos::Fdatime_p &p) {
   if(!ownFd(p.handle))
     return forward();
 
+  // Buffered data would overwrite the time stamp later
+  if(!flushFd(p.handle.bytes[1]) || !syncFile(p.handle.bytes[1], false))
+    return rte(EWRITF);
+
   FsFile &file = files[p.handle.bytes[1]].reopen();
   if(!file)
     return rte(EIHNDL);
 
+  // Write pending metadata, it would overwrite the time stamp later
+  if(file.isWritable() && !file.sync())
+    return rte(EWRITF);
+
   if(p.wflag) {
     // Set time
     DOSTIME dt;
@@ -2018,6 +2839,7 @@ bool GemDrive::onFdatime(const Tos::Fdatime_p &p) {
     // value in the library.
     uint16_t time = dt.time;
     uint16_t date = dt.date;
+    invalidateListings();
     file.timestamp(T_WRITE,
         FS_YEAR(date),
         FS_MONTH(date),
@@ -2043,22 +2865,468 @@ bool GemDrive::onFdatime(const Tos::Fdatime_p &p) {
   return rte(E_OK);
 }
 
+bool GemDrive::onFcopy(const Tos::Fcopy_p &p) {
+  // Let TOS answer EINVFN: the caller falls back to Fread/Fwrite
+  if(!ownFd(p.srchandle) || !ownFd(p.dsthandle))
+    return forward();
+
+  int src = p.srchandle.bytes[1];
+  int dst = p.dsthandle.bytes[1];
+  GemFile &srcFile = files[src];
+  GemFile &dstFile = files[dst];
+  if(!srcFile || !dstFile)
+    return rte(EIHNDL);
+
+  // Both handles would share the same position
+  if(srcFile == dstFile)
+    return rte(EACCDN);
+
+  if(!dstFile.isWritable() || !srcFile.checkMedium() || !dstFile.checkMedium())
+    return rte(EACCDN);
+
+  int size = p.count;
+  if(size < 0)
+    return rte(ERANGE);
+
+  // File size changes
+  invalidateListings();
+#if ! ACSI_PIO
+  // Data changes
+  dropReadCache();
+#endif
+
+  if(!flushFd(src) || !syncFile(src, false)
+      || !syncFile(dst, true) || !flushFd(dst, true))
+    return rte(EWRITF);
+
+  // Never copy past the end of the source, so a huge count means "up to the
+  // end" and does not preallocate more than needed.
+  FsFile &srcFs = srcFile.reopen();
+  if(!srcFs)
+    return rte(EREADF);
+  uint32_t left = srcFs.fileSize() > srcFile.position ?
+    srcFs.fileSize() - srcFile.position : 0;
+  if((uint32_t)size > left)
+    size = left;
+
+  // Reserve space for the whole copy at once
+  dstFile.preallocate(size);
+
+  // Data goes from one SD card to the other through buf, the ST only gets the
+  // byte count.
+  int done = 0;
+  while(size > 0) {
+    int bufSize = size > (int)sizeof(buf) ? (int)sizeof(buf) : size;
+
+    int readBytes = srcFile.read(buf, bufSize);
+    if(readBytes < 0)
+      return rte(EREADF);
+    if(readBytes == 0)
+      break;
+
+    if(dstFile.write(buf, readBytes) != readBytes)
+      return rte(EWRITF);
+
+    done += readBytes;
+    size -= readBytes;
+  }
+
+  return rte(ToLong(done));
+}
+
+bool GemDrive::onFxattr(const Tos::Fxattr_p &p) {
+  char *path;
+  GemDrive *drive = getDrive(p.name, &path);
+  if(!drive)
+    return forward();
+  if(!path)
+    return rte(EFILNF);
+
+  GemPath parent = drive->curPath;
+  GemPattern name;
+  if(!parent.openPath(path, name))
+    return rte(EPTHNF);
+
+  XATTR xattr;
+  if(name.isEmpty() || name.isCurDir() || name.isParentDir()) {
+    // The path designates a directory
+    if(name.isParentDir() && !parent.parent())
+      return rte(EPTHNF);
+    drive->fillDirXattr(xattr, parent);
+  } else {
+    FsFile file;
+    if(!parent.openFile(name, file) || !file)
+      return rte(EFILNF);
+
+    if(file.isDir()) {
+      drive->fillDirXattr(xattr, file);
+    } else {
+      uint16_t time;
+      uint16_t date;
+      file.getModifyDateTime(&date, &time);
+      drive->fillXattr(xattr, file.attrib(), time, date,
+          (uint32_t)file.fileSize(),
+          fileInode(TinyFile::getCluster(parent), file.dirIndex() + 1));
+    }
+  }
+
+  sendAt(xattr, p.xattr);
+
+  return rte(E_OK);
+}
+
+#if ACSI_GEMDRIVE_MAX_DIRS
+bool GemDrive::onDopendir(const Tos::Dopendir_p &p) {
+  char *path;
+  GemDrive *drive = getDrive(p.name, &path);
+  if(!drive)
+    return forward();
+  if(!path)
+    return rte(EPTHNF);
+
+  GemPath dirPath = drive->curPath;
+  GemPattern name;
+  if(!dirPath.openPath(path, name, true) || !dirPath.isDir())
+    return rte(EPTHNF);
+
+  // Needed to report the inode of ".."
+  uint32_t parentCluster = 0;
+  if(!dirPath.isRoot()) {
+    GemPath parentPath = dirPath;
+    if(parentPath.parent())
+      parentCluster = TinyFile::getCluster(parentPath);
+  }
+
+  for(int d = 0; d < dirsMax; ++d) {
+    GemDirHandle &dir = dirs[d];
+    if(dir)
+      continue;
+
+    // Match everything except volume labels
+    dir.dta.file.set(dirPath.mediaId, dirPath);
+    dir.dta.pattern = GemPattern("???????????");
+    dir.dta.attribMask = 0x16;
+    dir.parentCluster = parentCluster;
+    dir.basePage = getBasePage();
+    dir.compat = p.flag.bytes[1] & 1;
+    dir.open = true;
+
+    return rte(ToLong('G', 'D', 0x32 + Devices::acsiFirstId, d));
+  }
+
+  return rte(ENHNDL);
+}
+
+bool GemDrive::onDreaddir(const Tos::Dreaddir_p &p) {
+  return readDir(p.len, p.dirhandle, p.buf, ToLong(0), ToLong(0));
+}
+
+bool GemDrive::onDxreaddir(const Tos::Dxreaddir_p &p) {
+  return readDir(p.len, p.dirhandle, p.buf, p.xattr, p.xret);
+}
+
+bool GemDrive::onDrewinddir(const Tos::Drewinddir_p &p) {
+  GemDirHandle *dir = getDir(p.dirhandle);
+  if(!dir)
+    return forward();
+  if(!*dir)
+    return rte(EIHNDL);
+
+  // Restart with '.'
+  dir->dta.file.index = 0;
+
+  return rte(E_OK);
+}
+
+bool GemDrive::onDclosedir(const Tos::Dclosedir_p &p) {
+  GemDirHandle *dir = getDir(p.dirhandle);
+  if(!dir)
+    return forward();
+  if(!*dir)
+    return rte(EIHNDL);
+
+  dir->open = false;
+
+  return rte(E_OK);
+}
+#endif
+
+void GemDrive::onReset() {
+#if ! ACSI_PIO
+  // The resident driver is gone with the ST RAM
+  driverVars = 0;
+  prefetchBuf = 0;
+  prefetchLive = false;
+  readCacheBuf = 0;
+  readCacheFd = -1;
+  driverBounce = 0;
+  setDriverExt(false);
+#endif
+  trackProcess = false;
+  processChanged();
+  dropScript();
+#if ACSI_GEMDRIVE_BOOT_RECORD
+  // Interrupted boots are not recorded
+  bootRecordDrive = nullptr;
+#endif
+  closeAll();
+}
+
 void GemDrive::closeAll() {
   for(int i = 0; i < filesMax; ++i) {
     GemFile &file = files[i];
     if(file)
-      file.close();
+      closeFd(i);
+  }
+#if ACSI_GEMDRIVE_MAX_DIRS
+  for(int d = 0; d < dirsMax; ++d)
+    dirs[d].open = false;
+#endif
+}
+
+void GemDrive::ejected(uint32_t mediaId) {
+  // Cached state is not valid anymore
+  TinyFile::ejected(mediaId);
+#if ACSI_GEMDRIVE_DIR_INDEXES
+  GemDirIndex::invalidate();
+#endif
+#if ACSI_GEMDRIVE_LISTINGS
+  // ST batches belong to their DTA, which holds the medium id
+  GemDirListing::invalidate();
+#endif
+  GemPath::invalidateCache();
+  for(int i = 0; i < driveCount; ++i)
+    if(Devices::drives[i].freeMediaId == mediaId)
+      Devices::drives[i].invalidateFree();
+}
+
+bool GemDrive::closeFd(int fd) {
+  // Closing sets the archive flag and trims preallocated clusters
+  if(files[fd].isWritable())
+    invalidateListings();
+#if ! ACSI_PIO
+  dropReadCache(fd);
+#endif
+  bool success = flushFd(fd, true);
+  return files[fd].close() && success;
+}
+
+bool GemDrive::bufferWrite(int fd, uint32_t ptr, int size) {
+#if ACSI_GEMDRIVE_FILE_BUFFERS
+  GemFile &file = files[fd];
+  GemFileBuffer *buffer = getBuffer(fd);
+  if(!buffer)
+    return false;
+
+  // Flush the buffer if the write cannot be appended to it
+  if(*buffer
+      && (!buffer->dirty
+        || buffer->offset + buffer->size != file.position
+        || buffer->size + size > GemFileBuffer::bufSize))
+    if(!buffer->flush())
+      return false;
+
+  if(!*buffer) {
+    buffer->fd = fd;
+    buffer->dirty = true;
+    buffer->offset = file.position;
+    buffer->size = 0;
+  }
+
+  readAt(&buffer->data[buffer->size], ptr, size);
+  buffer->size += size;
+  buffer->lastUse = millis();
+  file.position += size;
+
+  return true;
+#else
+  return false;
+#endif
+}
+
+int GemDrive::bufferRead(int fd, uint32_t ptr, int size) {
+  int done = 0;
+#if ACSI_GEMDRIVE_FILE_BUFFERS && ACSI_GEMDRIVE_READ_AHEAD_MIN
+  GemFile &file = files[fd];
+  GemFileBuffer *buffer = getBuffer(fd);
+  if(!buffer)
+    return 0;
+
+  while(size > 0) {
+    if(!buffer->contains(file.position)) {
+      // Grow the window while reads are sequential, shrink it back when the
+      // program jumps around
+      int window = GemFileBuffer::windowMin;
+      if(*buffer && file.position == buffer->offset + buffer->size)
+        window = buffer->window * 2;
+      if(window < size)
+        window = size;
+      if(window > GemFileBuffer::bufSize)
+        window = GemFileBuffer::bufSize;
+
+      buffer->fd = fd;
+      buffer->dirty = false;
+      buffer->window = window;
+      buffer->offset = file.position;
+
+      int readBytes = file.read(buffer->data, window);
+      file.position = buffer->offset;
+      if(readBytes <= 0) {
+        // Error or end of file: let the caller handle it
+        buffer->fd = -1;
+        break;
+      }
+      buffer->size = readBytes;
+    }
+
+    int start = file.position - buffer->offset;
+    int count = buffer->size - start;
+    if(count > size)
+      count = size;
+
+    sendAt(ptr, &buffer->data[start], count);
+    file.position += count;
+    done += count;
+    ptr += count;
+    size -= count;
+  }
+
+  buffer->lastUse = millis();
+#endif
+  return done;
+}
+
+bool GemDrive::flushFd(int fd, bool release) {
+#if ACSI_GEMDRIVE_FILE_BUFFERS
+  for(int b = 0; b < fileBuffersMax; ++b) {
+    GemFileBuffer &buffer = fileBuffers[b];
+    if(buffer.fd == fd && (buffer.dirty || release))
+      return buffer.flush();
+  }
+#endif
+  return true;
+}
+
+bool GemDrive::syncFile(int fd, bool writing) {
+  bool success = true;
+#if ACSI_GEMDRIVE_FILE_BUFFERS
+  // Write pending data of other descriptors pointing at the same file, and
+  // drop their read-ahead if the file is about to change.
+  for(int b = 0; b < fileBuffersMax; ++b) {
+    GemFileBuffer &buffer = fileBuffers[b];
+    if(buffer && buffer.fd != fd && files[buffer.fd] == files[fd]
+        && (buffer.dirty || writing))
+      if(!buffer.flush())
+        success = false;
+  }
+#endif
+  return success;
+}
+
+#if ACSI_GEMDRIVE_FILE_BUFFERS
+GemFileBuffer * GemDrive::getBuffer(int fd) {
+  GemFileBuffer *oldest = nullptr;
+  uint32_t now = millis();
+
+  for(int b = 0; b < fileBuffersMax; ++b) {
+    GemFileBuffer &candidate = fileBuffers[b];
+    if(candidate.fd == fd)
+      return &candidate;
+    if(!oldest || !candidate
+        || (*oldest && now - candidate.lastUse > now - oldest->lastUse))
+      oldest = &candidate;
   }
+
+  // Use a free buffer or steal the one unused for the longest time
+  if(!oldest->flush())
+    return nullptr;
+
+  return oldest;
+}
+#endif
+
+void GemDrive::flushAll() {
+#if ACSI_GEMDRIVE_FILE_BUFFERS
+  for(int b = 0; b < fileBuffersMax; ++b)
+    fileBuffers[b].flush();
+#endif
+  TinyFile::syncDirty();
+}
+
+void GemDrive::invalidateListings() {
+#if ACSI_GEMDRIVE_LISTINGS
+  GemDirListing::invalidate();
+#endif
+#if ! ACSI_PIO
+  clearPrefetch();
+#endif
+}
+
+uint32_t GemDrive::freeClusterCount() {
+  // Detect medium swap
+  sd.mediaId();
+
+  while(!scanFree());
+
+  return freeClusters;
+}
+
+bool GemDrive::scanFree() {
+  uint32_t mediaId = sd.mediaId(BlockDev::CACHED);
+  if(sd.mode != SdDev::GEMDRIVE || !sd.mountable || !mediaId)
+    return true;
+
+  if(freeMediaId != mediaId) {
+    // Start counting
+    freeMediaId = mediaId;
+    freeValid = false;
+    freeClusters = 0;
+    freeScanSector = 0;
+  }
+
+  if(freeValid)
+    return true;
+
+  int32_t free = TinyFile::countFreeClusters(sd.fs, freeScanSector);
+  if(free >= 0) {
+    freeClusters += free;
+    ++freeScanSector;
+    return false;
+  }
+
+  if(free < -1)
+    // Use the slow method
+    freeClusters = sd.fs.freeClusterCount();
+
+  dbg("SD", sd.slot, " free=", freeClusters, ' ');
+  freeValid = true;
+  return true;
+}
+
+void GemDrive::adjustFree(int32_t clusters) {
+  if(freeValid && freeMediaId == sd.mediaId(BlockDev::CACHED))
+    freeClusters += clusters;
+  else
+    // Changed while counting: start again
+    invalidateFree();
+}
+
+void GemDrive::updateFree(uint64_t sizeBefore, uint64_t sizeAfter) {
+  uint32_t clusterSize = sd.fs.bytesPerCluster();
+  uint32_t before = (sizeBefore + clusterSize - 1) / clusterSize;
+  uint32_t after = (sizeAfter + clusterSize - 1) / clusterSize;
+  if(before != after)
+    adjustFree((int32_t)before - (int32_t)after);
 }
 
 void GemDrive::installHook(uint32_t driverMem, ToLong vector) {
   static const Long xbra = ToLong('X', 'B', 'R', 'A');
   static const Long a2st = ToLong('A', '2', 'S', 'T');
 
-  for(unsigned int i = 0; i < GEMDRIVE_boot_bin_len - 14; i += 2) {
+  for(unsigned int i = 0; i < GEMDRIVE_drv_bin_len - 14; i += 2) {
     // Scan XBRA/A2ST marker
-    if(GEMDRIVE_boot_bin[i] == 'X') {
-      Long *lbin = (Long *)(&GEMDRIVE_boot_bin[i]);
+    if(GEMDRIVE_drv_bin[i] == 'X') {
+      const Long *lbin = (const Long *)(&GEMDRIVE_drv_bin[i]);
       if(lbin[0] == xbra && lbin[1] == a2st && lbin[2] == vector) {
         // Marker found: install the hook to ST RAM
         Long oldVector = readLongAt(vector);
@@ -2079,9 +3347,201 @@ void GemDrive::setCurDrive(uint8_t driveId) {
 }
 
 Long GemDrive::getBasePage() {
-  return readLongAt(p_run);
+  if(!shadowBasePageValid) {
+    shadowBasePage = readLongAt(p_run);
+    shadowBasePageValid = true;
+  }
+  return shadowBasePage;
+}
+
+uint32_t GemDrive::getDta() {
+  if(!shadowDtaValid) {
+    // Cheaper than a Fgetdta call
+    shadowDta = readLongAt(getBasePage() + offsetof(BASEPAGE, p_dta));
+    shadowDtaValid = true;
+  }
+  return shadowDta;
+}
+
+void GemDrive::processChanged() {
+  shadowBasePageValid = false;
+  shadowDtaValid = false;
+}
+
+#if ! ACSI_PIO
+void GemDrive::initDriverExt() {
+  prefetchBuf = 0;
+  driverBounce = 0;
+  prefetchLive = false;
+
+  if(!driverVars)
+    return;
+
+  GemDriverVars vars;
+  readAt(vars, driverVars);
+  vars.p_run = p_run;
+
+  // The driver signals process switches with command 0x0d
+  trackProcess = true;
+
+  // Use the buffer provided by the driver, or allocate one
+  static const uint32_t prefetchSize =
+    sizeof(GemPrefetchHeader) + sizeof(GemDriveDTA) * (prefetchMax + 1);
+  if(prefetchMax && !vars.prefetch) {
+    vars.prefetch = Malloc(prefetchSize);
+    vars.prefetchSize = vars.prefetch ? prefetchSize : 0;
+  }
+  if(prefetchMax && vars.prefetchSize >= sizeof(GemPrefetchHeader) + sizeof(GemDriveDTA) * 2) {
+    prefetchBuf = vars.prefetch;
+    prefetchCount = ((uint32_t)vars.prefetchSize - sizeof(GemPrefetchHeader)) / sizeof(GemDriveDTA) - 1;
+    if(prefetchCount > prefetchMax)
+      prefetchCount = prefetchMax;
+  }
+
+  // Same for the Fread cache
+  static const uint32_t readCacheAlloc = sizeof(GemReadCacheHeader) + readCacheMax;
+  if(readCacheMax && !vars.readCache) {
+    vars.readCache = Malloc(readCacheAlloc);
+    vars.readCacheSize = vars.readCache ? readCacheAlloc : 0;
+  }
+  readCacheBuf = 0;
+  readCacheFd = -1;
+  if(readCacheMax && vars.readCacheSize > sizeof(GemReadCacheHeader)) {
+    readCacheBuf = vars.readCache;
+    readCacheSize = (uint32_t)vars.readCacheSize - sizeof(GemReadCacheHeader);
+    if(readCacheSize > readCacheMax)
+      readCacheSize = readCacheMax;
+  }
+
+  vars.prefetch = prefetchBuf;
+  vars.readCache = readCacheBuf;
+
+#if ACSI_GEMDRIVE_HOOK_SCRIPT && ACSI_GEMDRIVE_BOUNCE_BUFFER
+  // Allocate a bounce buffer in ST RAM if the ST has TT-RAM
+  static const uint32_t bounceAlloc = ACSI_GEMDRIVE_BOUNCE_BUFFER;
+  if(!vars.bounce && (ACSI_GEMDRIVE_NO_DIRECT_DMA || ramvalid() == 0x1357bd13)) {
+    // Mxalloc doesn't exist on older TOS
+    uint32_t bounce = Mxalloc(bounceAlloc, 0);
+    if((int32_t)bounce <= 0)
+      bounce = Malloc(bounceAlloc);
+    if((int32_t)bounce > 0 && bounce + bounceAlloc > SysHook::phystop) {
+      Mfree(bounce);
+      bounce = 0;
+    }
+    vars.bounce = (int32_t)bounce > 0 ? bounce : 0;
+    vars.bounceSize = vars.bounce ? bounceAlloc : 0;
+  }
+#endif
+  driverBounce = vars.bounce;
+  driverBounceSize = vars.bounceSize;
+
+  // Let the driver forward calls that GemDrive doesn't process.
+  // Other units may share the same driver.
+  memset(vars.filter, 0, sizeof(vars.filter));
+  for(const auto &f: gemdosFilters)
+    vars.setFilter(f.op, f.filter);
+  vars.handles |= 1 << Devices::acsiFirstId;
+  uint32_t drives = vars.drives;
+  for(int d = 0; d < driveCount; ++d)
+    if(Devices::drives[d].id < 26)
+      drives |= 1 << Devices::drives[d].id;
+  vars.drives = drives;
+
+  sendAt(vars, driverVars);
+
+  // Drop any batch left by a previous session
+  prefetchLive = prefetchBuf;
+  clearPrefetch();
+
+  if(readCacheBuf) {
+    // Reset the Fread cache and publish its counters
+    GemReadCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    sendAt(header, readCacheBuf);
+    readCacheMisses = 0;
+    setCookie(ToLong('A', '2', 'R', 'C'), readCacheBuf);
+  }
+
+  dbgHex("prefetch:", prefetchBuf, " read cache:", readCacheBuf,
+         " bounce:", driverBounce, ' ');
+}
+
+void GemDrive::fillReadCache(int fd) {
+  static_assert(sizeof(GemReadCacheHeader) + readCacheMax <= bufSize,
+      "ACSI_GEMDRIVE_ST_READ_CACHE too big for the data buffer");
+
+  dropReadCache();
+
+  // Read the following bytes of the file in the data buffer
+  GemFile &file = files[fd];
+  GemReadCacheHeader &header = *(GemReadCacheHeader *)buf;
+  int32_t readBytes = file.read(&buf[sizeof(header)], readCacheSize);
+  if(readBytes <= 0)
+    return;
+
+  header.misses = readCacheMisses;
+  header.handle = ToWord(0x32 + Devices::acsiFirstId, fd);
+  header.reserved = 0;
+  header.left = readBytes;
+  header.next = readCacheBuf + sizeof(header);
+
+  // Upload everything except the hit counter owned by the ST
+  static const int skip = offsetof(GemReadCacheHeader, misses);
+  sendAt(readCacheBuf + skip, &buf[skip], sizeof(header) - skip + readBytes);
+  readCacheFd = fd;
+}
+
+void GemDrive::dropReadCache(int fd) {
+  if(readCacheFd < 0 || (fd >= 0 && fd != readCacheFd))
+    return;
+
+  // Rewind the file to the first byte not read by the ST
+  Long left;
+  readAt(left, readCacheBuf + offsetof(GemReadCacheHeader, left));
+  files[readCacheFd].position -= left;
+
+  static const Word noHandle = ToWord(0);
+  sendAt(noHandle, readCacheBuf + offsetof(GemReadCacheHeader, handle));
+  readCacheFd = -1;
+}
+
+bool GemDrive::setCookie(ToLong id, ToLong value) {
+  Long jar = _p_cookies();
+  if(!jar)
+    return false;
+
+  for(uint32_t i = 0;; ++i) {
+    Long entry[2];
+    readAt(entry, jar + i * sizeof(entry));
+
+    if(entry[0] == id) {
+      // Update an existing cookie
+      sendAt(value, jar + i * sizeof(entry) + sizeof(Long));
+      return true;
+    }
+
+    if(!entry[0]) {
+      // End of the jar: the last entry holds its capacity
+      if(i + 1 >= entry[1])
+        return false;
+      Long entries[4] = { id, value, ToLong(0), entry[1] };
+      sendAt(entries, jar + i * sizeof(entry));
+      return true;
+    }
+  }
 }
 
+void GemDrive::clearPrefetch() {
+  if(!prefetchLive)
+    return;
+
+  // Make the ST send Fsnext calls to the STM32 again
+  static const Long empty = ToLong(0);
+  sendAt(empty, prefetchBuf + offsetof(GemPrefetchHeader, left));
+  prefetchLive = false;
+}
+#endif
+
 GemDrive * GemDrive::getDrive(const char *path, const char **outPath) {
   if(path[0] && path[1] == ':') {
     // Absolute path: check drive letter
@@ -2126,9 +3586,17 @@ GemDrive * GemDrive::getDrive(char *path, char **outPath) {
 GemDrive * GemDrive::getDrive(Long pathAddr, char **outPath) {
   char *path = (char *)buf;
 
+  // Files could be accessed by path while they have buffered writes
+  flushAll();
+
   readStringAt(path, pathAddr, sizeof(buf));
   dbg("path='", path, "' ");
 
+#if ACSI_GEMDRIVE_BOOT_RECORD
+  if(bootRecordDrive)
+    recordBootPath(path);
+#endif
+
   return getDrive(path, outPath);
 }
 
@@ -2162,12 +3630,23 @@ void GemDrive::closeProcessFiles() {
   for(int fi = 0; fi < filesMax; ++fi) {
     GemFile &file = files[fi];
     if(file && file.basePage == basePage) {
-      file.close();
+      closeFd(fi);
+#if ACSI_DEBUG
+      ++total;
+#endif
+    }
+  }
+#if ACSI_GEMDRIVE_MAX_DIRS
+  for(int d = 0; d < dirsMax; ++d) {
+    GemDirHandle &dir = dirs[d];
+    if(dir && dir.basePage == basePage) {
+      dir.open = false;
 #if ACSI_DEBUG
       ++total;
 #endif
     }
   }
+#endif
 #if ACSI_DEBUG
   if(total)
     dbg("Leaked ", total, " fd ");
@@ -2183,6 +3662,76 @@ bool GemDrive::ownFd(Word fd) {
   return fd.bytes[0] == 0x32 + Devices::acsiFirstId && fd.bytes[1] < filesMax;
 }
 
+#if ACSI_GEMDRIVE_MAX_DIRS
+GemDirHandle * GemDrive::getDir(Long handle) {
+  if(handle.bytes[0] != 'G' || handle.bytes[1] != 'D'
+      || handle.bytes[2] != 0x32 + Devices::acsiFirstId
+      || handle.bytes[3] >= dirsMax)
+    return nullptr;
+
+  return &dirs[handle.bytes[3]];
+}
+
+bool GemDrive::readDir(Word len, Long handle, Long buf, Long xattr, Long xret) {
+  GemDirHandle *dir = getDir(handle);
+  if(!dir)
+    return forward();
+  if(!*dir)
+    return rte(EIHNDL);
+
+  GemDrive *drive = getDrive(dir->dta.file.mediaId, BlockDev::CACHED);
+  if(!drive)
+    return rte(EIHNDL);
+
+  // Make sure that file sizes are up to date
+  flushAll();
+
+  // Keep the entry for the next call if it does not fit
+  GemDriveDTA dta = dir->dta;
+  if(!drive->nextDTA(dta))
+    return rte(ENMFIL);
+
+  uint32_t inode;
+  if(dta.file.index == TinyFile::CURRENT)
+    inode = dirInode(dta.file.dirCluster);
+  else if(dta.file.index == TinyFile::PARENT)
+    inode = dirInode(dir->parentCluster);
+  else if(dta.d_attrib & 0x10)
+    inode = dirInode(TinyFile::getCluster(dta.file.open(drive->sd.fs)));
+  else
+    inode = fileInode(dta.file.dirCluster, dta.file.index);
+
+  // Entry: optional index followed by the name
+  uint8_t entry[sizeof(Long) + sizeof(dta.d_fname)];
+  int size = 0;
+  if(!dir->compat) {
+    ToLong(inode).set(entry);
+    size = sizeof(Long);
+  }
+  int nameSize = strlen(dta.d_fname) + 1;
+  memcpy(&entry[size], dta.d_fname, nameSize);
+  size += nameSize;
+
+  if(size > (int16_t)len)
+    return rte(ERANGE);
+
+  dir->dta = dta;
+  sendAt(buf, entry, size);
+  dbg("-> ", dta.d_fname, ' ');
+
+  if(xattr) {
+    // Dxreaddir: attributes come with the name
+    XATTR x;
+    drive->fillXattr(x, dta.d_attrib, dta.d_time, dta.d_date, dta.d_length,
+        inode);
+    sendAt(x, xattr);
+    sendAt(ToLong(0), xret);
+  }
+
+  return rte(E_OK);
+}
+#endif
+
 const char * GemDrive::toUnicode(const GemPath &path) {
   char *unicode = (char *)buf;
   int len = path.toUnicode(unicode, sizeof(buf));
@@ -2230,6 +3779,15 @@ uint32_t GemDrive::loadPrg(FsFile &prgFile, Long cmdline, Long env, uint32_t &ba
   dbg("Loading ", name, ' ');
 #endif
 
+#if ACSI_GEMDRIVE_RELOC_CACHE
+  // Identify the program for the relocation cache
+  RelocCacheHeader relKey;
+  relKey.magic = relocCacheMagic;
+  relKey.cluster = TinyFile::getCluster(prgFile);
+  relKey.size = prgFile.fileSize();
+  prgFile.getModifyDateTime(&relKey.date, &relKey.time);
+#endif
+
   // Read program header
   PH ph;
   if(prgFile.read(&ph, sizeof(ph)) != sizeof(ph))
@@ -2279,6 +3837,10 @@ uint32_t GemDrive::loadPrg(FsFile &prgFile, Long cmdline, Long env, uint32_t &ba
   // the offset.
   // For very large offsets this procedure can of course be repeated.
   // Incidentally, an empty relocation table is flagged with a LONG value of 0.
+  //
+  // If ACSI_GEMDRIVE_RELOC_CACHE is enabled, the decoded table is stored as a
+  // bitmap in the relocation cache the first time a program is loaded. The
+  // next times, fixups are read from the bitmap instead of the table.
 
   // Load the binary
   uint32_t prgStart = basepage + sizeof(PD);
@@ -2286,12 +3848,36 @@ uint32_t GemDrive::loadPrg(FsFile &prgFile, Long cmdline, Long env, uint32_t &ba
   uint32_t prgSize = ph.ph_tlen + ph.ph_dlen;
   uint32_t prgOffset = 0;
   int block;
+  int carry = 0; // Bytes kept at the start of buf for the next block
   FsFile relFile = prgFile;
   int relTableIndex = 0;
   int relTableSize = 0;
   int relOffset = -1; // means "no relocation"
+#if ACSI_GEMDRIVE_RELOC_CACHE
+  FsFile relCache;
+  uint32_t relEntry = 0; // Position of the entry in relCache
+  uint32_t relChunk = 0; // Bitmap byte in relTableCache[0]
+  bool relCached = false; // Fixups come from the bitmap
+  bool relBuild = false; // Fixups are stored into a new bitmap
+  uint8_t relBits[64]; // Bitmap being written
+  uint32_t relBitsBase = 0; // Bitmap byte in relBits[0]
+  relKey.bitmapSize = (prgSize + 15) / 16;
+
+  if(!ph.ph_absflag) {
+    relCached = openRelocCache(relCache, relKey, relEntry);
+    if(relCached) {
+      relOffset = nextCachedFixup(relCache, relKey.bitmapSize, relChunk, relTableSize, 0);
+      if(relOffset == -2)
+        goto relocationFailed;
+      if(relOffset >= 0)
+        relOffset *= 2;
+    }
+  }
 
+  if(!relCached && !ph.ph_absflag) {
+#else
   if(!ph.ph_absflag) {
+#endif
     // Load reloction offset
     Long ro;
     relFile.seek(sizeof(ph) + ph.ph_tlen + ph.ph_dlen + ph.ph_slen);
@@ -2300,19 +3886,41 @@ uint32_t GemDrive::loadPrg(FsFile &prgFile, Long cmdline, Long env, uint32_t &ba
     relOffset = ro;
     if(!relOffset)
       relOffset = -1;
+
+#if ACSI_GEMDRIVE_RELOC_CACHE
+    if(relOffset >= 0 && createRelocEntry(relCache, relKey, relEntry)) {
+      // Store fixups while decoding the table. The entry is marked complete
+      // at the end.
+      RelocCacheHeader header = relKey;
+      header.magic = 0;
+      relBuild = relCache.write(&header, sizeof(header)) == sizeof(header);
+      memset(relBits, 0, sizeof(relBits));
+    }
+#endif
   }
 
   if(relOffset >= 0)
     verbose("Relocations:\n");
 
   do {
-    // Read program block
-    block = (prgSize - prgOffset > sizeof(buf)) ? sizeof(buf) : prgSize - prgOffset;
-    block = prgFile.read(buf, block);
+    // Read program block after the carried bytes.
+    // End reads on a sector boundary so the next ones are aligned.
+    uint32_t filePos = sizeof(ph) + prgOffset + carry;
+    uint32_t readEnd = (filePos + sizeof(buf) - carry) & ~(uint32_t)0x1ff;
+    block = readEnd > filePos ? readEnd - filePos : sizeof(buf) - carry;
+    if((uint32_t)block > prgSize - prgOffset - carry)
+      block = prgSize - prgOffset - carry;
+    block = prgFile.read(&buf[carry], block);
     if(block < 0)
       goto relocationFailed;
-    if(!block)
+    if(!block) {
+      if(carry)
+        // A relocated address crosses the end of the program
+        goto relocationFailed;
       break;
+    }
+    block += carry;
+    carry = 0;
 
     if(relOffset >= 0) {
       // Relocate block
@@ -2321,10 +3929,8 @@ uint32_t GemDrive::loadPrg(FsFile &prgFile, Long cmdline, Long env, uint32_t &ba
 
         if(relOffset + 4 > block) {
           // No luck: the address is in the middle of the loading block.
-          // Just shift block size and resume relocation at next iteration.
-          int shift = block - relOffset;
-          if(!prgFile.seekCur(-shift))
-            goto relocationFailed;
+          // Keep its first bytes for the next block.
+          carry = block - relOffset;
           block = relOffset;
           break;
         }
@@ -2336,11 +3942,46 @@ uint32_t GemDrive::loadPrg(FsFile &prgFile, Long cmdline, Long env, uint32_t &ba
         verboseHex(" -> ", (uint32_t)value, '\n');
         value.set(&buf[relOffset]);
 
+#if ACSI_GEMDRIVE_RELOC_CACHE
+        if(relCached) {
+          // Point at the next bit set in the bitmap
+          int32_t word = nextCachedFixup(relCache, relKey.bitmapSize, relChunk,
+              relTableSize, (prgOffset + relOffset) / 2 + 1);
+          if(word == -2)
+            goto relocationFailed;
+          if(word < 0) {
+            relOffset = -1;
+            break;
+          }
+          relOffset = word * 2 - prgOffset;
+          continue;
+        }
+
+        if(relBuild) {
+          uint32_t offset = prgOffset + relOffset;
+          uint32_t byte = offset / 16;
+          while(relBuild && byte >= relBitsBase + sizeof(relBits)) {
+            relBuild = relCache.write(relBits, sizeof(relBits)) == sizeof(relBits);
+            memset(relBits, 0, sizeof(relBits));
+            relBitsBase += sizeof(relBits);
+          }
+          if(offset & 1)
+            // Cannot be represented in the bitmap
+            relBuild = false;
+          if(relBuild)
+            relBits[byte - relBitsBase] |= 1 << (offset / 2 & 7);
+        }
+#endif
+
         // Load more relocation info if needed
 loadRelocationInfo:
         if(relTableIndex == relTableSize) {
-          // Need to load more relocation info
-          relTableSize = relFile.read(relTableCache, sizeof(relTableCache));
+          // Need to load more relocation info.
+          // Keep reads on sector boundaries.
+          int chunk = sizeof(relTableCache);
+          if(chunk >= 512)
+            chunk -= relFile.curPosition() & 0x1ff;
+          relTableSize = relFile.read(relTableCache, chunk);
           relTableIndex = 0;
           verbose("Loaded ", relTableSize, " bytes\n");
           if(relTableSize < 0)
@@ -2372,21 +4013,169 @@ loadRelocationInfo:
     }
 
     sendAt(prgPtr, buf, block);
+    memmove(buf, &buf[block], carry);
 
     prgPtr += block;
     prgOffset += block;
-  } while(block > 0);
+  } while(block > 0 || carry);
+
+#if ACSI_GEMDRIVE_RELOC_CACHE
+  if(relCache && !relCached) {
+    uint64_t sizeBefore = relEntry;
+    if(relBuild) {
+      // Write the end of the bitmap, then mark the entry as complete
+      while(relBuild && relBitsBase < relKey.bitmapSize) {
+        int size = relKey.bitmapSize - relBitsBase;
+        if(size > (int)sizeof(relBits))
+          size = sizeof(relBits);
+        relBuild = (int)relCache.write(relBits, size) == size;
+        memset(relBits, 0, sizeof(relBits));
+        relBitsBase += size;
+      }
+      relBuild = relBuild
+        && relCache.seekSet(relEntry)
+        && relCache.write(&relKey, sizeof(relKey)) == sizeof(relKey);
+    }
+    if(relBuild)
+      dbg("reloc cached ");
+    else
+      relCache.truncate(relEntry);
+
+    // Hidden, not to clutter the desktop
+    relCache.attrib(0x02);
+    updateFree(sizeBefore, relCache.fileSize());
+  }
+  relCache.close();
+#endif
 
   return E_OK;
 
 relocationFailed:
   verbose("Reloc failed\n");
+#if ACSI_GEMDRIVE_RELOC_CACHE
+  if(relCache && !relCached) {
+    uint64_t sizeBefore = relCache.fileSize();
+    relCache.truncate(relEntry);
+    updateFree(sizeBefore, relCache.fileSize());
+  }
+  relCache.close();
+#endif
   Mfree(basepage);
   return EPLFMT;
 }
 
+#if ACSI_GEMDRIVE_RELOC_CACHE
+bool GemDrive::openRelocCache(FsFile &cache, const RelocCacheHeader &key, uint32_t &entry) {
+  entry = 0;
+
+  // Lookups never create the file
+  cache = sd.fs.open(ACSI_GEMDRIVE_RELOC_CACHE_FILE, O_RDONLY);
+  if(!cache)
+    return false;
+
+  // Walk through entries
+  RelocCacheHeader header;
+  while(cache.seekSet(entry)
+      && cache.read(&header, sizeof(header)) == sizeof(header)
+      && header.magic == relocCacheMagic) {
+    if(header.cluster == key.cluster
+        && header.size == key.size
+        && header.date == key.date
+        && header.time == key.time
+        && header.bitmapSize == key.bitmapSize) {
+      dbg("reloc cache hit ");
+      return true;
+    }
+    entry += sizeof(header) + header.bitmapSize;
+  }
+
+  cache.close();
+  return false;
+}
+
+bool GemDrive::createRelocEntry(FsFile &cache, const RelocCacheHeader &key, uint32_t &entry) {
+  if(!sd.isWritable())
+    return false;
+
+  if(!sd.fs.exists(ACSI_GEMDRIVE_RELOC_CACHE_FILE)) {
+    // Creating the file changes the root directory
+#if ACSI_GEMDRIVE_DIR_INDEXES
+    GemDirIndex::invalidate();
+#endif
+    invalidateListings();
+  }
+
+  cache = sd.fs.open(ACSI_GEMDRIVE_RELOC_CACHE_FILE, O_CREAT | O_RDWR);
+  if(!cache)
+    return false;
+
+  // Make room for the new entry after the last complete one
+  uint64_t sizeBefore = cache.fileSize();
+  if(entry + sizeof(RelocCacheHeader) + key.bitmapSize > (uint32_t)ACSI_GEMDRIVE_RELOC_CACHE * 1024)
+    entry = 0;
+  if(sizeof(RelocCacheHeader) + key.bitmapSize > (uint32_t)ACSI_GEMDRIVE_RELOC_CACHE * 1024
+      || !cache.truncate(entry)
+      || !cache.seekSet(entry)) {
+    cache.truncate(0);
+    updateFree(sizeBefore, cache.fileSize());
+    cache.close();
+    return false;
+  }
+  updateFree(sizeBefore, cache.fileSize());
+
+  return true;
+}
+
+int32_t GemDrive::nextCachedFixup(FsFile &cache, uint32_t bitmapSize,
+    uint32_t &chunk, int &chunkSize, uint32_t word) {
+  for(;;) {
+    uint32_t byte = word / 8;
+    if(byte >= bitmapSize)
+      return -1;
+
+    if(byte >= chunk + chunkSize) {
+      // Load the next chunk of bitmap
+      chunk += chunkSize;
+      int size = sizeof(relTableCache);
+      if(size > (int)(bitmapSize - chunk))
+        size = bitmapSize - chunk;
+      chunkSize = cache.read(relTableCache, size);
+      if(chunkSize <= 0)
+        return -2;
+      continue;
+    }
+
+    uint8_t bits = relTableCache[byte - chunk] >> (word & 7);
+    if(bits)
+      return word + __builtin_ctz(bits);
+
+    // Skip to the next byte
+    word = (word | 7) + 1;
+  }
+}
+#endif
+
 bool GemDrive::scanDTA(GemDriveDTA &dta, uint32_t noFileErr) {
+  if(!nextDTA(dta))
+    return rte(noFileErr);
+
+  // Success: upload DTA and return from system call
+  uint32_t dtaAddr = getDta();
+  sendAt(dta, dtaAddr);
+  dbg("-> ", dta.d_fname, ' ');
+
+#if ! ACSI_PIO
+  // Let the ST answer the next Fsnext calls by itself
+  if(prefetchBuf && !(dtaAddr & 1) && dta.pattern.hasWildcards())
+    prefetchDTA(dta, dtaAddr);
+#endif
+
+  return rte(E_OK);
+}
+
+bool GemDrive::nextDTA(GemDriveDTA &dta) {
   GemPattern fileName;
+  GemPatternMatcher matcher(dta.pattern);
 
   do {
     // Inject '.' and '..' in subfolders
@@ -2413,6 +4202,22 @@ bool GemDrive::scanDTA(GemDriveDTA &dta, uint32_t noFileErr) {
     }
 
     // Scan normal files
+#if ACSI_GEMDRIVE_LISTINGS
+    {
+      const GemDirListing::Entry *entry = GemDirListing::next(dta.file, sd.fs);
+      if(entry) {
+        dta.file.index = entry->index;
+        fileName = entry->name;
+        dta.d_attrib = entry->attrib;
+        dta.d_time = ToWord(entry->time);
+        dta.d_date = ToWord(entry->date);
+        dta.d_length = ToLong(entry->length);
+      } else {
+        dta.file.index = 0;
+        fileName.clear();
+      }
+    }
+#else
 scanFile:
     FsFile &file = dta.file.openNext(sd.fs);
     if(file) {
@@ -2429,23 +4234,239 @@ scanFile:
     } else {
       fileName.clear();
     }
-  } while(fileName && (dta.pattern != fileName || !GemPattern::attribMatching(dta.attribMask, dta.d_attrib)));
+#endif
+  } while(fileName && (!matcher.matches(fileName) || !GemPattern::attribMatching(dta.attribMask, dta.d_attrib)));
 
   if(!fileName)
-    return rte(noFileErr);
+    return false;
 
   fileName.toAtari(dta.d_fname);
+  return true;
+}
 
-  // Success: upload DTA and return from system call
-  sendAt(dta, Fgetdta());
-  dbg("-> ", dta.d_fname, ' ');
-  return rte(E_OK);
+#if ! ACSI_PIO
+void GemDrive::prefetchDTA(const GemDriveDTA &dta, uint32_t dtaAddr) {
+  static_assert(sizeof(GemDriveDTA) == 44, "GemDriveDTA must match the TOS DTA");
+  static_assert(sizeof(GemPrefetchHeader) + sizeof(GemDriveDTA) * (prefetchMax + 1) <= bufSize,
+      "ACSI_GEMDRIVE_ST_PREFETCH too big for the data buffer");
+
+  // Build the batch in the data buffer. The first image is the DTA just sent,
+  // so the ST can check that it is unchanged before each Fsnext.
+  GemPrefetchHeader &header = *(GemPrefetchHeader *)buf;
+  GemDriveDTA *images = (GemDriveDTA *)&buf[sizeof(GemPrefetchHeader)];
+  images[0] = dta;
+
+  int count;
+  for(count = 0; count < prefetchCount; ++count) {
+    images[count + 1] = images[count];
+    if(!nextDTA(images[count + 1]))
+      break;
+  }
+
+  header.dta = dtaAddr;
+  header.next = prefetchBuf + sizeof(GemPrefetchHeader) + sizeof(GemDriveDTA);
+  header.left = count;
+  header.end = count < prefetchCount;
+
+  sendAt(prefetchBuf, buf, sizeof(GemPrefetchHeader) + sizeof(GemDriveDTA) * (count + 1));
+  prefetchLive = true;
+  dbg("prefetched:", count, header.end ? " end " : " ");
 }
+#endif
+
+#if ACSI_GEMDRIVE_BOOT_RECORD
+void GemDrive::loadBootRecord(GemDrive *drive) {
+  bootRecordDrive = drive;
+  bootRecordMediaId = drive->sd.mediaId();
+  bootRecordStart = millis();
+  bootRecordSize = 0;
+  bootRecordCount = 0;
+  bootReplaySize = 0;
+  bootReplayNext = 0;
+  bootReplayCount = 0;
+
+  FsFile file = drive->sd.fs.open(ACSI_GEMDRIVE_BOOT_RECORD_FILE);
+  if(!file)
+    return;
+
+  // One path per line. Store them as a sequence of C strings, in the same
+  // format as bootRecord.
+  int size = file.read(bootReplay, sizeof(bootReplay) - 1);
+  file.close();
+  int n = 0;
+  for(int i = 0; i < size; ++i) {
+    char c = bootReplay[i];
+    if(c == '\r')
+      continue;
+    if(c == '\n')
+      c = 0;
+    if(c || (n && bootReplay[n - 1]))
+      bootReplay[n++] = c;
+  }
+  if(n && bootReplay[n - 1])
+    bootReplay[n++] = 0;
+  bootReplaySize = n;
+
+  dbg("boot record:", bootReplaySize, ' ');
+}
+
+void GemDrive::recordBootPath(const char *path) {
+  // Paths are recorded from the root of their drive: the current directory
+  // is not known when they are replayed.
+  const char *relPath;
+  GemDrive *drive = getDrive(path, &relPath);
+  if(!drive || !relPath)
+    return;
+
+  // Relative to a subdirectory: the full path is not known here
+  if(relPath[0] != '\\' && !drive->curPath.isRoot())
+    return;
+
+  char prefix[3] = { drive->letter(), ':', '\\' };
+  int prefixSize = relPath[0] == '\\' ? 2 : 3;
+
+  int size = prefixSize + strlen(relPath) + 1;
+  if(bootRecordSize + size > bootRecordMax)
+    return;
+
+  // Record each path once
+  for(int i = 0; i < bootRecordSize; i += strlen(&bootRecord[i]) + 1)
+    if(!memcmp(&bootRecord[i], prefix, prefixSize)
+        && !strcmp(&bootRecord[i + prefixSize], relPath))
+      return;
+
+  memcpy(&bootRecord[bootRecordSize], prefix, prefixSize);
+  strcpy(&bootRecord[bootRecordSize + prefixSize], relPath);
+  bootRecordSize += size;
+  ++bootRecordCount;
+}
+
+bool GemDrive::replayBootPath() {
+  // Stay a few paths ahead of the ST, caches are small
+  if(bootReplayNext >= bootReplaySize
+      || bootReplayCount >= bootRecordCount + bootReplayAhead)
+    return false;
+
+  const char *path = &bootReplay[bootReplayNext];
+  bootReplayNext += strlen(path) + 1;
+  ++bootReplayCount;
+
+  const char *relPath;
+  GemDrive *drive = getDrive(path, &relPath);
+  if(!drive || !relPath)
+    return true;
+
+  dbg("replay '", path, "' ");
+
+  // Recorded paths start at the root of the drive
+  GemPath dir = drive->curPath;
+  GemPattern name;
+  if(!dir.openPath(relPath, name))
+    return true;
+
+  if(name.hasWildcards()) {
+#if ACSI_GEMDRIVE_LISTINGS
+    // Fsfirst will start with this listing page
+    TinyFile start;
+    start.set(dir.mediaId, dir);
+    GemDirListing::next(start, drive->sd.fs);
+#endif
+  } else if(name.isFileName()) {
+    // Index the name in its directory
+    FsFile file;
+    dir.openFile(name, file);
+  }
+
+  return true;
+}
+
+void GemDrive::saveBootRecord() {
+  GemDrive *drive = bootRecordDrive;
+  bootRecordDrive = nullptr;
+
+  // Nothing changed since the previous boot
+  if(!bootRecordSize || (bootRecordSize == bootReplaySize
+        && !memcmp(bootRecord, bootReplay, bootRecordSize)))
+    return;
+
+  // The card was swapped during boot
+  if(drive->sd.mediaId() != bootRecordMediaId)
+    return;
+
+  dbg("save boot record ");
+
+  FsFile file = drive->sd.fs.open(ACSI_GEMDRIVE_BOOT_RECORD_FILE, O_CREAT | O_RDWR);
+  if(!file)
+    return;
+
+#if ACSI_GEMDRIVE_DIR_INDEXES
+  GemDirIndex::invalidate();
+#endif
+  invalidateListings();
+
+  uint64_t sizeBefore = file.fileSize();
+  if(file.truncate(0)) {
+    for(int i = 0; i < bootRecordSize; i += strlen(&bootRecord[i]) + 1) {
+      file.write(&bootRecord[i], strlen(&bootRecord[i]));
+      file.write("\r\n", 2);
+    }
+  }
+  drive->updateFree(sizeBefore, file.fileSize());
+
+  // Hidden, not to clutter the desktop
+  file.attrib(0x02);
+  file.close();
+}
+#endif
 
 char GemDrive::letter() const {
   return 'A' + id;
 }
 
+void GemDrive::fillXattr(XATTR &xattr, uint8_t attrib, uint16_t time,
+    uint16_t date, uint32_t length, uint32_t inode) {
+  static_assert(sizeof(XATTR) == 52, "XATTR must match the MiNT structure");
+
+  uint32_t blockSize = sd.fs.bytesPerCluster();
+
+  memset(&xattr, 0, sizeof(xattr));
+
+  // Unix mode: type and rwx permissions, without write if read-only
+  xattr.mode = (attrib & 0x10 ? 0040000 : 0100000)
+             | (attrib & 0x01 ? 0555 : 0777);
+  xattr.index = inode;
+  xattr.dev = id;
+  xattr.nlink = 1;
+  xattr.size = length;
+  xattr.blksize = blockSize;
+  xattr.nblocks = (length + blockSize - 1) / blockSize;
+  xattr.mtime = xattr.atime = xattr.ctime = time;
+  xattr.mdate = xattr.adate = xattr.cdate = date;
+  xattr.attr = attrib;
+}
+
+void GemDrive::fillDirXattr(XATTR &xattr, FsFile &dir) {
+  // The root directory has no date
+  uint16_t time = 0;
+  uint16_t date = 0;
+  if(dir.isSubDir())
+    dir.getModifyDateTime(&date, &time);
+
+  fillXattr(xattr, 0x10, time, date, 0, dirInode(TinyFile::getCluster(dir)));
+}
+
+uint32_t GemDrive::dirInode(uint32_t cluster) {
+  // Cluster numbers start at 2. getCluster returns 0 for the root directory.
+  return cluster ? cluster : 1;
+}
+
+uint32_t GemDrive::fileInode(uint32_t dirCluster, uint16_t index) {
+  // Bit 31 is never set in a cluster number, so files never collide with
+  // directories. Files are unique for directories in the first 32768
+  // clusters, higher clusters are folded.
+  return 0x80000000 | ((dirCluster ^ dirCluster >> 15) & 0x7fff) << 16 | index;
+}
+
 Word GemDrive::createFd(GemPath &parent, FsFile &file, oflag_t oflag) {
   for(int i = 0; i < filesMax; ++i) {
     if(!files[i]) {
@@ -2459,12 +4480,54 @@ Word GemDrive::createFd(GemPath &parent, FsFile &file, oflag_t oflag) {
 }
 
 GemFile GemDrive::files[GemDrive::filesMax]; // File descriptors
+#if ACSI_GEMDRIVE_BOOT_RECORD
+GemDrive * GemDrive::bootRecordDrive;
+uint32_t GemDrive::bootRecordMediaId;
+uint32_t GemDrive::bootRecordStart;
+char GemDrive::bootRecord[GemDrive::bootRecordMax];
+int GemDrive::bootRecordSize;
+int GemDrive::bootRecordCount;
+char GemDrive::bootReplay[GemDrive::bootRecordMax];
+int GemDrive::bootReplaySize;
+int GemDrive::bootReplayNext;
+int GemDrive::bootReplayCount;
+#endif
+#if ACSI_GEMDRIVE_MAX_DIRS
+GemDirHandle GemDrive::dirs[GemDrive::dirsMax];
+#endif
+#if ACSI_GEMDRIVE_DIR_INDEXES
+GemDirIndex GemDirIndex::indexes[GemDirIndex::indexesMax];
+#endif
+#if ACSI_GEMDRIVE_LISTINGS
+GemDirListing GemDirListing::listings[GemDirListing::listingsMax];
+int GemDirListing::nextFill = 0;
+#endif
+#if ACSI_GEMDRIVE_FILE_BUFFERS
+GemFileBuffer GemDrive::fileBuffers[GemDrive::fileBuffersMax];
+#endif
 uint8_t GemDrive::relTableCache[ACSI_GEMDRIVE_RELTABLE_CACHE_SIZE];
 GemDrive * GemDrive::curDrive = nullptr; // Drive index. nullptr if unknown.
 Long GemDrive::os_beg;
 Word GemDrive::os_version;
 Word GemDrive::os_conf;
 Long GemDrive::p_run;
+bool GemDrive::trackProcess;
+bool GemDrive::shadowBasePageValid;
+Long GemDrive::shadowBasePage;
+bool GemDrive::shadowDtaValid;
+uint32_t GemDrive::shadowDta;
+#if ! ACSI_PIO
+uint32_t GemDrive::driverVars;
+uint32_t GemDrive::driverBounce;
+int GemDrive::driverBounceSize;
+uint32_t GemDrive::prefetchBuf;
+int GemDrive::prefetchCount;
+bool GemDrive::prefetchLive;
+uint32_t GemDrive::readCacheBuf;
+int GemDrive::readCacheSize;
+int GemDrive::readCacheFd = -1;
+uint32_t GemDrive::readCacheMisses;
+#endif
 
 #endif
 
@@ -46,6 +46,10 @@ struct TOS_PACKED GemPattern {
 
   bool parseUnicode(const char *name);
   bool parseFileName(FsFile &file);
+
+  // Parses a raw 8.3 directory entry name
+  // Returns false if the name needs to go through parseUnicode
+  bool parseShortName(const DirFat_t *entry);
   const char * parseAtari(const char *path);
   char * parseAtari(char *path) {
     return (char *)parseAtari(path);
@@ -90,6 +94,16 @@ struct TOS_PACKED GemPattern {
   char pattern[11];
 };
 
+// Pattern precomputed to be matched against many names, word by word
+struct GemPatternMatcher {
+  GemPatternMatcher(const GemPattern &pattern);
+
+  bool matches(const GemPattern &name) const;
+
+  uint32_t value[3];
+  uint32_t mask[3]; // Bits to compare. '?' characters are ignored.
+};
+
 // GemDrive DTA, compatible with TOS DTA
 struct TOS_PACKED GemDriveDTA {
   TinyFile file;
@@ -102,6 +116,55 @@ struct TOS_PACKED GemDriveDTA {
   uint8_t attribMask;
 };
 
+// Variables of the resident driver extensions (asm/GEMDRIVE/ext.s)
+struct TOS_PACKED GemDriverVars {
+  Long magic; // 'A2EX'
+  Long self; // Address of this structure in ST RAM
+  Long p_run; // Address of the current basepage pointer
+  Long prefetch; // Fsnext prefetch buffer, 0 if none
+  Long prefetchSize; // Size of the prefetch buffer if provided by the driver
+  Long readCache; // Fread cache, 0 if none
+  Long readCacheSize; // Size of the Fread cache if provided by the driver
+  Long drives; // Bit n set if drive n belongs to GemDrive
+  uint8_t handles; // Bit n set if handles 0x32+n belong to GemDrive
+  uint8_t reserved;
+
+  // GEMDOS call filter: 2 bits per opcode, first opcode in the lowest bits.
+  // Opcodes above the map are always sent to the STM32.
+  static const uint8_t FORWARD = 0; // Let TOS process the call
+  static const uint8_t SEND = 1; // Send the call to the STM32
+  static const uint8_t HANDLE = 2; // Send if the handle at offset 2 is ours
+  static const uint8_t PATH = 3; // Send if the path at offset 2 is on our drives
+  static const int filterOps = 128;
+  uint8_t filter[filterOps / 4];
+
+  Long bounce; // ST RAM bounce buffer, 0 if none
+  Long bounceSize; // Size of the bounce buffer
+
+  void setFilter(int op, uint8_t value) {
+    filter[op / 4] |= value << (op % 4 * 2);
+  }
+};
+
+// Header of the Fsnext prefetch buffer in ST RAM, followed by DTA images
+struct TOS_PACKED GemPrefetchHeader {
+  Long dta; // DTA address the batch belongs to
+  Long next; // Next DTA image to return
+  Word left; // Number of images left
+  Word end; // Non-zero if there are no more files after the batch
+};
+
+// Header of the Fread cache in ST RAM, followed by cached data.
+// The 'A2RC' cookie points at this structure.
+struct TOS_PACKED GemReadCacheHeader {
+  Long hits; // Fread calls served by the ST
+  Long misses; // Small Fread calls served by the STM32
+  Word handle; // Cached file handle, 0 if none
+  Word reserved;
+  Long left; // Bytes left in the cache
+  Long next; // Address of the next byte to return
+};
+
 struct GemPath: public FsFile {
   GemPath(SdDev &sd);
   GemPath & operator=(const GemPath &other);
@@ -130,26 +193,161 @@ struct GemPath: public FsFile {
 
   bool openPath(const char *pathStr, GemPattern &last, bool parseLastName = false);
   bool openFile(const GemPattern &name, FsFile &file, oflag_t oflag = O_RDONLY);
+  bool openIndexed(const GemPattern &name, FsFile &file, oflag_t oflag);
 
   int toAtari(char *out, int bufSize) const;
   int toUnicode(char *out, int bufSize) const;
 
   bool isContainedBy(FsFile &file) const;
 
+  // Forget cached paths. Must be called when directories are moved or deleted.
+  static void invalidateCache();
+
 protected:
   static const int maxDepth = ACSI_GEMDRIVE_MAX_PATH;
   uint16_t indexes[maxDepth];
   SdDev &sd;
+
+#if ACSI_GEMDRIVE_PATH_CACHE
+  // Resolved directory, found either by the path string used to reach it or
+  // by its indexes
+  struct CacheEntry {
+    static const int pathMax = 64;
+
+    uint32_t pathKey; // Hash of the start directory and path string, 0 if none
+    uint32_t startCluster; // Directory the path string starts from
+    uint32_t mediaId; // 0 if unused
+    uint32_t lastUse;
+    uint16_t indexes[maxDepth];
+    char path[pathMax]; // Path string, without terminating zero if full
+    FsFile dir;
+
+    // Returns true if the entry was reached with this path string
+    bool matches(uint32_t startCluster, const char *path, const char *end) const;
+
+    // Forget the directory without syncing the volume
+    void forget() {
+      mediaId = 0;
+      TinyFile::forget(dir);
+    }
+  };
+  static CacheEntry cache[ACSI_GEMDRIVE_PATH_CACHE];
+
+  // Cached Dgetpath string
+  static uint32_t atariMediaId;
+  static uint32_t atariCluster;
+  static char atariPath[128];
+
+  // Returns 0 if the path string is too long to be cached
+  static uint32_t hashPath(uint32_t startCluster, const char *path, const char *end);
+
+  // Look up a directory by path string, or by indexes if path is nullptr
+  bool loadCache(uint32_t pathKey = 0, const char *path = nullptr, const char *end = nullptr);
+  void storeCache(uint32_t pathKey = 0, uint32_t startCluster = 0, const char *path = nullptr, const char *end = nullptr);
+#endif
 public:
   uint32_t mediaId;
 };
 
+#if ACSI_GEMDRIVE_DIR_INDEXES
+// Hash index of the file names of a directory.
+// Filled while scanning the directory for a name, so it is never slower than
+// a plain scan.
+struct GemDirIndex {
+  struct Entry {
+    uint16_t hash;
+    uint16_t index; // Directory index + 1, 0 if the slot is free
+  };
+
+  // Returns the index of a directory, recycles the least recently used one if
+  // needed
+  static GemDirIndex & get(uint32_t mediaId, uint32_t dirCluster);
+
+  // Forget all indexes. Must be called when directory contents change.
+  static void invalidate();
+
+  static uint16_t hash(const GemPattern &name);
+
+  // Find the first indexed file matching name in directory dir.
+  // Returns its directory index + 1, or 0 if not found.
+  uint16_t find(FsFile &dir, const GemPattern &name, uint16_t hash);
+
+  // Add a name to the index. Returns false if the index is full.
+  bool insert(uint16_t hash, uint16_t dirIndex);
+
+  void clear();
+
+  static const int size = ACSI_GEMDRIVE_DIR_INDEX_SIZE;
+  static const int indexesMax = ACSI_GEMDRIVE_DIR_INDEXES;
+  static GemDirIndex indexes[indexesMax];
+
+  uint32_t mediaId; // 0 if unused
+  uint32_t dirCluster;
+  uint32_t lastUse;
+  uint32_t position; // Position in the directory where indexing stopped
+  uint16_t count; // Number of names in the index
+  bool complete; // All names of the directory are indexed
+  Entry entries[size];
+};
+#endif
+
+#if ACSI_GEMDRIVE_LISTINGS
+// Page of consecutive visible files of a directory, as returned by Fsnext.
+// Filled in one pass over the directory.
+struct GemDirListing {
+  struct TOS_PACKED Entry {
+    GemPattern name;
+    uint8_t attrib;
+    uint16_t time;
+    uint16_t date;
+    uint32_t length;
+    uint16_t index; // TinyFile index of the file
+  };
+
+  // Returns the file following file in its directory, filling a new page if
+  // needed. Returns nullptr at the end of the directory.
+  static const Entry * next(const TinyFile &file, FsVolume &volume);
+
+  // Forget all pages. Must be called when directory contents change.
+  static void invalidate();
+
+  // Fill the page with files following file
+  void fill(const TinyFile &file, FsVolume &volume);
+
+  static const int size = ACSI_GEMDRIVE_LISTING_SIZE;
+  static const int listingsMax = ACSI_GEMDRIVE_LISTINGS;
+  static GemDirListing listings[listingsMax];
+  static int nextFill; // Page to recycle
+
+  uint32_t mediaId; // 0 if unused
+  uint32_t dirCluster;
+  uint16_t startIndex; // TinyFile index preceding the first entry
+  uint8_t count;
+  bool complete; // The page reaches the end of the directory
+  Entry entries[size];
+};
+#endif
+
 struct GemFile: public TinyFile {
   void set(GemPath &parent, FsFile &file, oflag_t oflag, Long basePage);
 
+  // Close the file and commit deferred metadata
+  bool close();
+
   FsFile & reopen();
   int32_t read(uint8_t *data, int32_t size);
   int32_t write(uint8_t *data, int32_t size);
+
+  // Reserve contiguous clusters before writing an empty file
+  void preallocate(uint32_t size);
+
+  // Report an allocation change to the free space counter of the drive
+  void updateFree(uint64_t sizeBefore, uint64_t sizeAfter) const;
+
+  // Bytes allocated on the SD card, including preallocated space
+  uint64_t allocatedSize(FsFile &file) const {
+    return file.fileSize() > preallocated ? file.fileSize() : preallocated;
+  }
   int32_t seek(int32_t offset, int whence);
 
   bool checkMedium() const;
@@ -158,8 +356,63 @@ struct GemFile: public TinyFile {
   uint32_t position; // Current seek position
   Long basePage;
   oflag_t oflag;
+  bool archive; // Set the archive flag when closing
+  uint32_t preallocated; // Bytes reserved by preallocate()
+  bool writeError; // A deferred buffer write failed
 };
 
+#if ACSI_GEMDRIVE_FILE_BUFFERS
+// RAM buffer attached to a file descriptor.
+// Coalesces small writes to avoid a SD card access for each of them, or keeps
+// a read-ahead window to serve small reads.
+struct GemFileBuffer {
+  GemFileBuffer(): fd(-1) {}
+
+  // Returns true if the buffer is attached to a file descriptor
+  operator bool() const {
+    return fd >= 0;
+  }
+
+  // Returns true if the read-ahead window contains this file position
+  bool contains(uint32_t position) const {
+    return fd >= 0 && !dirty && position >= offset && position - offset < size;
+  }
+
+  // Write buffered data to the file if needed and release the buffer.
+  // Returns false if data could not be written.
+  bool flush();
+
+  static const int bufSize = ACSI_GEMDRIVE_FILE_BUFFER_SIZE;
+  static const int windowMin = ACSI_GEMDRIVE_READ_AHEAD_MIN;
+
+  int16_t fd; // Index in GemDrive::files, -1 if free
+  bool dirty; // true if it holds written data, false if it holds read-ahead
+  uint16_t window; // Current read-ahead window size
+  uint16_t size; // Number of bytes in the buffer
+  uint32_t offset; // Position of the first byte in the file
+  uint32_t lastUse; // Timestamp of the last access in milliseconds
+  uint8_t data[bufSize];
+};
+#endif
+
+#if ACSI_GEMDRIVE_MAX_DIRS
+// Directory opened with Dopendir.
+// Scans like a DTA, but the scan state stays on the STM32.
+struct GemDirHandle {
+  GemDirHandle(): open(false) {}
+
+  operator bool() const {
+    return open;
+  }
+
+  GemDriveDTA dta; // Scan state
+  uint32_t parentCluster; // Cluster of the parent directory, for ".."
+  Long basePage; // Process that opened the directory
+  bool open;
+  bool compat; // TOS compatible mode: names are not preceded by an index
+};
+#endif
+
 struct GemDrive: public Devices, public Tos {
   GemDrive(SdDev &sd_);
 
@@ -170,6 +423,7 @@ struct GemDrive: public Devices, public Tos {
   static void onBoot();
   static void onInit(bool setBootDrive = false);
   static void onGemdos();
+  static void onIdle();
 
   // GEMDOS processing
 #define DECLARE_CALLBACK(name) \
@@ -178,6 +432,7 @@ struct GemDrive: public Devices, public Tos {
   DECLARE_CALLBACK(Pterm0);
   DECLARE_CALLBACK(Cconws);
   DECLARE_CALLBACK(Dsetdrv);
+  DECLARE_CALLBACK(Fsetdta);
   DECLARE_CALLBACK(Tgetdate);
   DECLARE_CALLBACK(Tsetdate);
   DECLARE_CALLBACK(Tgettime);
@@ -201,14 +456,35 @@ struct GemDrive: public Devices, public Tos {
   DECLARE_CALLBACK(Fsnext);
   DECLARE_CALLBACK(Frename);
   DECLARE_CALLBACK(Fdatime);
+  DECLARE_CALLBACK(Fcopy);
+  DECLARE_CALLBACK(Fxattr);
+#if ACSI_GEMDRIVE_MAX_DIRS
+  DECLARE_CALLBACK(Dopendir);
+  DECLARE_CALLBACK(Dreaddir);
+  DECLARE_CALLBACK(Dxreaddir);
+  DECLARE_CALLBACK(Drewinddir);
+  DECLARE_CALLBACK(Dclosedir);
+#endif
 
 #undef DECLARE_CALLBACK
 
   // Extra methods
+  static void onReset();
   static void closeAll();
+  static void ejected(uint32_t mediaId);
+  static bool closeFd(int fd);
+  static bool bufferWrite(int fd, uint32_t ptr, int size);
+  static int bufferRead(int fd, uint32_t ptr, int size);
+  static bool flushFd(int fd, bool release = false);
+  static bool syncFile(int fd, bool writing);
+  static void flushAll();
+  static void invalidateListings(); // Directory listings changed
   static void installHook(uint32_t driverMem, ToLong vector);
+  static bool setCookie(ToLong id, ToLong value);
   static void setCurDrive(uint8_t driveId);
   static Long getBasePage();
+  static uint32_t getDta();
+  static void processChanged(); // Forget the shadow of the process state
   static GemDrive * getDrive(const char *path, const char **outPath = nullptr);
   static GemDrive * getDrive(char *path, char **outPath = nullptr);
   static GemDrive * getDrive(Long pathAddr, char **outPath = nullptr);
@@ -217,6 +493,11 @@ struct GemDrive: public Devices, public Tos {
   static void closeProcessFiles();
   static oflag_t attribToSdFat(uint8_t attrib);
   static bool ownFd(Word fd);
+#if ACSI_GEMDRIVE_MAX_DIRS
+  // Returns the directory matching a Dopendir handle, nullptr if not ours
+  static GemDirHandle * getDir(Long handle);
+  static bool readDir(Word len, Long handle, Long buf, Long xattr, Long xret);
+#endif
   static const char * toUnicode(const GemPath &path);
   static const char * toUnicode(const GemPath &path, FsFile &file);
   static const char * toUnicode(const GemPath &path, GemPattern &name);
@@ -225,7 +506,37 @@ struct GemDrive: public Devices, public Tos {
   // Load a program from file into memory.
   // Returns a TOS error code or E_OK if successful.
   // Sets the basepage address on the ST RAM.
-  static uint32_t loadPrg(FsFile &prgFile, Long cmdline, Long env, uint32_t &basepage);
+  uint32_t loadPrg(FsFile &prgFile, Long cmdline, Long env, uint32_t &basepage);
+
+#if ACSI_GEMDRIVE_RELOC_CACHE
+  // Entry of the relocation cache file, followed by the bitmap
+  struct RelocCacheHeader {
+    uint32_t magic; // 0 until the bitmap is complete
+    uint32_t cluster; // First cluster of the program
+    uint32_t size; // Program file size
+    uint16_t date; // Program modification date
+    uint16_t time;
+    uint32_t bitmapSize; // In bytes
+  };
+  static const uint32_t relocCacheMagic = 0x4132524c; // 'A2RL'
+
+  // Look up the bitmap of a program in the relocation cache.
+  // Returns true if found, with cache positioned at the bitmap.
+  // Otherwise, cache is closed and entry is set after the last complete entry.
+  bool openRelocCache(FsFile &cache, const RelocCacheHeader &key, uint32_t &entry);
+
+  // Open or create the relocation cache to write a new entry at entry.
+  // Older entries are dropped if the file would grow too large.
+  // Returns false with cache closed if the entry cannot be stored.
+  bool createRelocEntry(FsFile &cache, const RelocCacheHeader &key, uint32_t &entry);
+
+  // Scan the bitmap for the next fixup, starting at word.
+  // The bitmap is read from cache by chunks into relTableCache.
+  // Returns the word index of the fixup, -1 at the end of the bitmap or -2 on
+  // read error.
+  static int32_t nextCachedFixup(FsFile &cache, uint32_t bitmapSize,
+      uint32_t &chunk, int &chunkSize, uint32_t word);
+#endif
 
   // Make rte return true and forward return false for code clearness
   static bool rte(int8_t value = 0) {
@@ -243,20 +554,61 @@ struct GemDrive: public Devices, public Tos {
 
   // Non-static methods
 
-  // Advance DTA to the next matching file
+  // Advance DTA to the next matching file, then upload it
   bool scanDTA(GemDriveDTA &dta, uint32_t noFileErr = ENMFIL);
 
+  // Advance DTA to the next matching file
+  // Returns false if there is no more file
+  bool nextDTA(GemDriveDTA &dta);
+
+#if ! ACSI_PIO
+  // Upload the matches following dta to the ST prefetch buffer
+  void prefetchDTA(const GemDriveDTA &dta, uint32_t dtaAddr);
+#endif
+
   // Return the drive letter on the ST
   char letter() const;
 
+  // Fill MiNT file attributes
+  void fillXattr(XATTR &xattr, uint8_t attrib, uint16_t time, uint16_t date,
+      uint32_t length, uint32_t inode);
+
+  // Fill MiNT attributes of a directory
+  void fillDirXattr(XATTR &xattr, FsFile &dir);
+
+  // MiNT inode numbers. Directories use their first cluster, other files use
+  // the cluster of their parent directory and their TinyFile index in it.
+  static uint32_t dirInode(uint32_t cluster);
+  static uint32_t fileInode(uint32_t dirCluster, uint16_t index);
+
   // Create a file descriptor for a file
   // Returns 0 if not possible
   Word createFd(GemPath &parent, FsFile &file, oflag_t oflag);
 
+  // Free space accounting
+  // The free cluster count is computed in the background, then adjusted after
+  // each allocation change done by GemDrive.
+  uint32_t freeClusterCount(); // Finishes counting if needed
+  bool scanFree(); // Count one more sector, returns true when done
+  void adjustFree(int32_t clusters);
+  void updateFree(uint64_t sizeBefore, uint64_t sizeAfter);
+  void invalidateFree() {
+    freeMediaId = 0;
+  }
+
   // Static variables
   static const int driveCount = Devices::sdCount;
   static const int filesMax = ACSI_GEMDRIVE_MAX_FILES;
   static GemFile files[filesMax]; // File descriptors
+#if ACSI_GEMDRIVE_MAX_DIRS
+  static const int dirsMax = ACSI_GEMDRIVE_MAX_DIRS;
+  static GemDirHandle dirs[dirsMax]; // Directories opened with Dopendir
+#endif
+#if ACSI_GEMDRIVE_FILE_BUFFERS
+  static const int fileBuffersMax = ACSI_GEMDRIVE_FILE_BUFFERS;
+  static GemFileBuffer fileBuffers[fileBuffersMax];
+  static GemFileBuffer * getBuffer(int fd);
+#endif
 
   static uint8_t relTableCache[ACSI_GEMDRIVE_RELTABLE_CACHE_SIZE];
   static GemDrive * curDrive; // Current drive
@@ -267,10 +619,71 @@ struct GemDrive: public Devices, public Tos {
   static Long p_run;
   static Long bootBasePage;
 
+  // Shadow of the state of the current process on the ST.
+  // Only kept between calls if the driver reports process changes.
+  static bool trackProcess;
+  static bool shadowBasePageValid;
+  static Long shadowBasePage;
+  static bool shadowDtaValid;
+  static uint32_t shadowDta;
+
+#if ! ACSI_PIO
+  // Resident driver extensions
+  static void initDriverExt();
+  static void clearPrefetch();
+  static uint32_t driverVars; // Address of GemDriverVars, 0 if no extensions
+  static uint32_t driverBounce; // Bounce buffer, enabled after initialization
+  static int driverBounceSize;
+  static uint32_t prefetchBuf; // Fsnext prefetch buffer, 0 if none
+  static int prefetchCount; // Number of DTA prefetched in each batch
+  static bool prefetchLive; // The prefetch buffer holds a batch
+  static const int prefetchMax = ACSI_GEMDRIVE_ST_PREFETCH;
+
+  // Fread cache on the ST
+  static void fillReadCache(int fd);
+  static void dropReadCache(int fd = -1); // Any fd if -1
+  static uint32_t readCacheBuf; // Fread cache, 0 if none
+  static int readCacheSize; // Data bytes in the cache
+  static int readCacheFd; // Cached file descriptor, -1 if none
+  static uint32_t readCacheMisses;
+  static const int readCacheMax = ACSI_GEMDRIVE_ST_READ_CACHE;
+#endif
+
+#if ACSI_GEMDRIVE_BOOT_RECORD
+
+#if ! ACSI_GEMDRIVE_PATH_CACHE && ! ACSI_GEMDRIVE_DIR_INDEXES
+#error ACSI_GEMDRIVE_BOOT_RECORD needs ACSI_GEMDRIVE_PATH_CACHE or ACSI_GEMDRIVE_DIR_INDEXES to replay paths into
+#endif
+
+  // Boot sequence recorder
+  static void loadBootRecord(GemDrive *drive);
+  static void recordBootPath(const char *path);
+  static bool replayBootPath(); // Returns false if there is nothing to do
+  static void saveBootRecord();
+  static GemDrive *bootRecordDrive; // Drive holding the recording, nullptr if stopped
+  static uint32_t bootRecordMediaId;
+  static uint32_t bootRecordStart;
+  static const int bootRecordMax = ACSI_GEMDRIVE_BOOT_RECORD;
+  static const int bootReplayAhead = 4; // Paths resolved ahead of the ST
+  static char bootRecord[bootRecordMax]; // Paths of this boot
+  static int bootRecordSize;
+  static int bootRecordCount;
+  static char bootReplay[bootRecordMax]; // Paths of the previous boot
+  static int bootReplaySize;
+  static int bootReplayNext; // Offset of the next path to resolve
+  static int bootReplayCount;
+#endif
+
   // Mounted drive variables
   SdDev &sd; // Pointer to the low-level SD card descriptor
   GemPath curPath;
   uint8_t id; // Drive id on the ST
+
+  // Free space accounting state
+  uint32_t freeMediaId; // Medium being counted, 0 if not started
+  uint32_t freeClusters;
+  uint32_t freeScanSector; // Next sector of the allocation table to count
+  bool freeValid; // Counting is finished
 };
 
 // vim: ts=2 sw=2 sts=2 et
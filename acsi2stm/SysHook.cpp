@@ -17,6 +17,14 @@
 
 #include "SysHook.h"
 
+#if ! ACSI_PIO && ACSI_GEMDRIVE_HOOK_SCRIPT
+uint8_t SysHook::script[SysHook::scriptMax];
+int SysHook::scriptSize = 0;
+bool SysHook::driverExt = false;
+uint32_t SysHook::bounceBuf = 0;
+int SysHook::bounceSize = 0;
+#endif
+
 Long SysHook::stackAlloc(int bytes)
 {
   // Read the stack pointer address
@@ -38,6 +46,16 @@ void SysHook::sendAt(uint32_t address, const uint8_t *bytes, int count)
 
 #if ! ACSI_PIO
   if(count < 16 || !isDma(address + count - 1)) {
+#if ACSI_GEMDRIVE_HOOK_SCRIPT
+    if(count >= 16 && bounceBuf) {
+      // Transfer through the bounce buffer
+      sendAtBounce(address, bytes, count);
+      return;
+    }
+
+    // Let the ST copy bytes from the script
+    scriptStore(address, bytes, count);
+#else
     // Indirect copy
 
     shiftStack(-32);
@@ -60,6 +78,7 @@ void SysHook::sendAt(uint32_t address, const uint8_t *bytes, int count)
     }
 
     shiftStack(32);
+#endif
     return;
   }
 
@@ -97,6 +116,14 @@ void SysHook::readAt(uint8_t *bytes, uint32_t source, int count)
 
 #if ! ACSI_PIO
   if(!isDma(source + count - 1)) {
+#if ACSI_GEMDRIVE_HOOK_SCRIPT
+    if(count >= 16 && bounceBuf) {
+      // Transfer through the bounce buffer
+      readAtBounce(bytes, source, count);
+      return;
+    }
+#endif
+
     // Read from outside DMA RAM: use slow indirect copy
     readAtIndirect(bytes, source, count);
     return;
@@ -177,6 +204,14 @@ void SysHook::clearAt(uint32_t bytes, uint32_t address) {
                        0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0};
 
 #if ! ACSI_PIO
+#if ACSI_GEMDRIVE_HOOK_SCRIPT
+  if(driverExt) {
+    // Let the ST fill memory by itself
+    scriptFill(address, bytes, 0);
+    return;
+  }
+#endif
+
   if(!isDma(address + bytes - 1)) {
     // Upload some blank bytes on the stack
     shiftStack(-32);
@@ -221,6 +256,189 @@ void SysHook::clearAt(uint32_t bytes, uint32_t address) {
 #endif
 }
 
+void SysHook::scriptStore(uint32_t address, const uint8_t *bytes, int count)
+{
+#if ! ACSI_PIO && ACSI_GEMDRIVE_HOOK_SCRIPT
+  while(count > 0) {
+    // Store operation: 1 byte opcode, 4 bytes address, 4 bytes count
+    int c = scriptMax - 5 - 9 - (scriptSize ? scriptSize : 5);
+    if(c <= 0) {
+      flushScript();
+      continue;
+    }
+    if(c > count)
+      c = count;
+
+    uint8_t *op = scriptOp(9 + c);
+    op[0] = 0x02;
+    ToLong(address).set(&op[1]);
+    ToLong(c - 1).set(&op[5]);
+    memcpy(&op[9], bytes, c);
+
+    address += c;
+    bytes += c;
+    count -= c;
+  }
+#else
+  (void)address;
+  (void)bytes;
+  (void)count;
+#endif
+}
+
+void SysHook::scriptCopy(uint32_t source, uint32_t target, uint32_t count)
+{
+#if ! ACSI_PIO && ACSI_GEMDRIVE_HOOK_SCRIPT
+  uint8_t *op = scriptOp(13);
+  op[0] = 0x03;
+  ToLong(source).set(&op[1]);
+  ToLong(target).set(&op[5]);
+  ToLong(count).set(&op[9]);
+#else
+  (void)source;
+  (void)target;
+  (void)count;
+#endif
+}
+
+void SysHook::scriptFill(uint32_t address, uint32_t count, uint8_t value)
+{
+#if ! ACSI_PIO && ACSI_GEMDRIVE_HOOK_SCRIPT
+  uint8_t *op = scriptOp(13);
+  op[0] = 0x05;
+  ToLong(address).set(&op[1]);
+  ToLong(count).set(&op[5]);
+  ToLong(value, value, value, value).set(&op[9]);
+#else
+  (void)address;
+  (void)count;
+  (void)value;
+#endif
+}
+
+void SysHook::flushScript()
+{
+#if ! ACSI_PIO && ACSI_GEMDRIVE_HOOK_SCRIPT
+  if(!scriptSize)
+    return;
+
+  // End of script: the ST sends a command byte when done
+  script[scriptSize] = 0x00;
+  sendScript(0x99, scriptSize + 1, true);
+#endif
+}
+
+#if ! ACSI_PIO && ACSI_GEMDRIVE_HOOK_SCRIPT
+uint8_t * SysHook::scriptOp(int size)
+{
+  // Keep 5 bytes for the final operation
+  if(scriptSize + size > scriptMax - 5)
+    flushScript();
+
+  if(!scriptSize) {
+    // Command byte and an unused parameter
+    memset(script, 0, 5);
+    scriptSize = 5;
+  }
+
+  uint8_t *op = &script[scriptSize];
+  scriptSize += size;
+  return op;
+}
+
+void SysHook::sendScript(uint8_t command, int size, bool wait)
+{
+  script[0] = command;
+  scriptSize = 0;
+  verboseHex("script(", size, ") ");
+  DmaPort::sendIrqFast(script, size);
+  if(wait)
+    waitCommand();
+}
+#endif
+
+void SysHook::setDriverExt(bool enable, uint32_t bounce, int size)
+{
+#if ! ACSI_PIO && ACSI_GEMDRIVE_HOOK_SCRIPT
+  driverExt = enable;
+  bounceBuf = enable && size >= 16 ? bounce : 0;
+  bounceSize = size & ~0xf;
+#else
+  (void)enable;
+  (void)bounce;
+  (void)size;
+#endif
+}
+
+void SysHook::sendAtBounce(uint32_t address, const uint8_t *bytes, int count)
+{
+#if ! ACSI_PIO && ACSI_GEMDRIVE_HOOK_SCRIPT
+  if(address & 1) {
+    // Unaligned access: write the first byte from the script
+    scriptStore(address, bytes, 1);
+    ++address;
+    ++bytes;
+    --count;
+  }
+
+  while(count > 0) {
+    int c = count > bounceSize ? bounceSize : count;
+
+    // This runs the copy of the previous block before overwriting the buffer
+    setDmaRead(bounceBuf);
+    sendDma(bytes, c & ~0xf);
+    if(c & 0xf) {
+      // DMA only writes whole 16 bytes blocks
+      uint8_t tail[16];
+      memset(tail, 0, sizeof(tail));
+      memcpy(tail, &bytes[c & ~0xf], c & 0xf);
+      sendDma(tail, sizeof(tail));
+    }
+
+    // Let the ST copy the buffer to its target
+    scriptCopy(bounceBuf, address, c);
+
+    address += c;
+    bytes += c;
+    count -= c;
+  }
+#else
+  (void)address;
+  (void)bytes;
+  (void)count;
+#endif
+}
+
+void SysHook::readAtBounce(uint8_t *bytes, uint32_t source, int count)
+{
+#if ! ACSI_PIO && ACSI_GEMDRIVE_HOOK_SCRIPT
+  if(source & 1) {
+    // Unaligned access: read the first byte in indirect mode
+    *bytes = readByteAt(source);
+    ++bytes;
+    ++source;
+    --count;
+  }
+
+  while(count > 0) {
+    int c = count > bounceSize ? bounceSize : count;
+
+    // Let the ST copy data to the buffer, then read it
+    scriptCopy(source, bounceBuf, c);
+    setDmaWrite(bounceBuf);
+    readDma(bytes, c);
+
+    bytes += c;
+    source += c;
+    count -= c;
+  }
+#else
+  (void)bytes;
+  (void)source;
+  (void)count;
+#endif
+}
+
 void SysHook::readDma(uint8_t *bytes, int count)
 {
   if(!count)
@@ -367,6 +585,13 @@ end_of_string:
 // Low level hook commands implementation
 
 void SysHook::rte(int8_t value) {
+#if ! ACSI_PIO && ACSI_GEMDRIVE_HOOK_SCRIPT
+  if(scriptSize) {
+    // Return at the end of the script
+    rte(ToLong(value));
+    return;
+  }
+#endif
   if(value <= (int8_t)0x9a)
     rte(ToLong(value));
   dbgHex("rte(", (uint32_t)(uint8_t)value, ") ");
@@ -374,6 +599,7 @@ void SysHook::rte(int8_t value) {
 }
 
 void SysHook::forward() {
+  flushScript();
   dbg("forward ");
   DmaPort::sendIrq(0x9a);
 }
@@ -416,11 +642,29 @@ void SysHook::pexec6ThenRte(ToLong pd) {
 
 void SysHook::setDmaRead(ToLong address)
 {
+#if ! ACSI_PIO && ACSI_GEMDRIVE_HOOK_SCRIPT
+  if(scriptSize && driverExt) {
+    // Set DMA at the end of the script
+    script[scriptSize] = 0x04;
+    address.set(&script[scriptSize + 1]);
+    sendScript(0x99, scriptSize + 5, true);
+    return;
+  }
+#endif
   sendCommand(0x85, address);
 }
 
 void SysHook::setDmaWrite(ToLong address)
 {
+#if ! ACSI_PIO && ACSI_GEMDRIVE_HOOK_SCRIPT
+  if(scriptSize && driverExt) {
+    // Set DMA at the end of the script
+    script[scriptSize] = 0x04;
+    address.set(&script[scriptSize + 1]);
+    sendScript(0x98, scriptSize + 5, true);
+    return;
+  }
+#endif
   sendCommand(0x84, address);
 }
 
@@ -436,6 +680,15 @@ void SysHook::copyToStack(ToLong address)
 
 void SysHook::rte(ToLong value) {
   dbgHex("rte(", (uint32_t)value, ") ");
+#if ! ACSI_PIO && ACSI_GEMDRIVE_HOOK_SCRIPT
+  if(scriptSize) {
+    // Return at the end of the script
+    script[scriptSize] = 0x01;
+    value.set(&script[scriptSize + 1]);
+    sendScript(0x99, scriptSize + 5, false);
+    return;
+  }
+#endif
   sendCommandNoWait(0x80, value);
 }
 
@@ -453,6 +706,9 @@ void SysHook::sendCommand(int command, ToLong param)
 
 void SysHook::sendCommandNoWait(int command, ToLong param)
 {
+  // Previous operations must be done before this command
+  flushScript();
+
   uint8_t bytes[5];
   bytes[0] = command;
   bytes[1] = param.bytes[0];
@@ -272,6 +272,42 @@ struct SysHook: public Monitor {
   // Clear memory
   static void clearAt(uint32_t bytes, uint32_t address);
 
+  // Hook scripts
+
+  // Memory writes are appended to a script. The ST runs the script in a single
+  // command, just before the next hook command.
+  // The script buffer must be at least 32 bytes.
+
+  // Append a memory write to the script
+  static void scriptStore(uint32_t address, const uint8_t *bytes, int count);
+
+  // Run the pending script, if any
+  static void flushScript();
+
+  // Forget the pending script without running it
+  static void dropScript() {
+#if ! ACSI_PIO && ACSI_GEMDRIVE_HOOK_SCRIPT
+    scriptSize = 0;
+#endif
+  }
+
+  // Operations below need the resident driver
+
+  // Enable resident driver operations and set its bounce buffer (0 if none)
+  static void setDriverExt(bool enable, uint32_t bounce = 0, int size = 0);
+
+  // Append a memory copy to the script.
+  // Faster if source and target have the same parity.
+  // Regions may overlap only if target is below source.
+  static void scriptCopy(uint32_t source, uint32_t target, uint32_t count);
+
+  // Append a memory fill to the script
+  static void scriptFill(uint32_t address, uint32_t count, uint8_t value);
+
+  // Bounce buffer transfers, for memory outside DMA range
+  static void sendAtBounce(uint32_t address, const uint8_t *bytes, int count);
+  static void readAtBounce(uint8_t *bytes, uint32_t source, int count);
+
 
   // DMA streaming helpers
 
@@ -387,6 +423,21 @@ struct SysHook: public Monitor {
   }
 
   static const uint32_t phystop = 0xe00000; // DMA-compatible range
+
+#if ! ACSI_PIO && ACSI_GEMDRIVE_HOOK_SCRIPT
+  static const int scriptMax = ACSI_GEMDRIVE_HOOK_SCRIPT;
+  static uint8_t script[scriptMax];
+  static int scriptSize;
+  static uint8_t * scriptOp(int size);
+  static void sendScript(uint8_t command, int size, bool wait);
+
+  // The resident driver runs hook commands
+  static bool driverExt;
+
+  // ST RAM bounce buffer, 0 if none
+  static uint32_t bounceBuf;
+  static int bounceSize;
+#endif
 };
 
 // vim: ts=2 sw=2 sts=2 et
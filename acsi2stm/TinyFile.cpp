@@ -45,6 +45,27 @@ FsFile & TinyFile::open(FsVolume &volume, oflag_t oflag) const {
     return lastFile;
   }
 
+  // Already opened
+  if(lastFile && lastId == *this && (oflag == O_RDONLY || lastFile.isWritable()))
+    return lastFile;
+
+  if(dirtyFile && dirtyId == *this) {
+    // Resume the file waiting for its metadata update
+    FsFile file;
+    file = dirtyFile;
+    forget(dirtyFile);
+    dirtyId = TinyFile();
+    closeLast();
+    lastFile = file;
+    forget(file);
+    lastId = *this;
+    lastMediaId = mediaId;
+    return lastFile;
+  }
+
+  if(oflag != O_RDONLY && !isDirty())
+    dirtyTime = millis();
+
   // Open the parent directory
   openParent(volume);
 
@@ -53,6 +74,8 @@ FsFile & TinyFile::open(FsVolume &volume, oflag_t oflag) const {
     return lastFile;
 
   lastFile.open(&lastParent, index - 1, oflag);
+  if(lastFile)
+    lastId = *this;
 
   return lastFile;
 }
@@ -114,9 +137,21 @@ FsFile & TinyFile::openParent(FsVolume &volume) const {
   return lastParent;
 }
 
-void TinyFile::close() {
+bool TinyFile::close() {
+  bool success = true;
+
+  // Commit pending metadata
+  if(lastFile && lastId == *this && lastFile.isWritable())
+    success = lastFile.close();
+  if(dirtyFile && dirtyId == *this) {
+    success = dirtyFile.close() && success;
+    dirtyId = TinyFile();
+  }
+
   index = 0;
   closeLast();
+
+  return success;
 }
 
 uint32_t TinyFile::getCluster(FsFile &file) {
@@ -144,9 +179,101 @@ void TinyFile::setCluster(FsFile &file, uint32_t cluster) {
     file.m_xFile->m_firstCluster = cluster;
 }
 
+const DirFat_t * TinyFile::getShortEntry(FsFile &file) {
+  if(!file.m_fFile || file.m_fFile->m_lfnOrd)
+    return nullptr;
+
+  // The entry was just read: it is still in the volume cache
+  return file.m_fFile->cacheDirEntry(FsCache::CACHE_FOR_READ);
+}
+
+int32_t TinyFile::countFreeClusters(FsVolume &volume, uint32_t sector) {
+  int32_t free = 0;
+
+  if(volume.m_fVol) {
+    auto *vol = volume.m_fVol;
+    int perSector;
+    if(vol->fatType() == 16)
+      perSector = 256;
+    else if(vol->fatType() == 32)
+      perSector = 128;
+    else
+      // FAT12 entries span across sectors
+      return -2;
+
+    // Clusters are numbered from 2
+    uint32_t first = sector * perSector;
+    uint32_t last = vol->clusterCount() + 1;
+    if(first > last)
+      return -1;
+
+    // Go through the FAT cache: it can hold unwritten allocations
+    const uint8_t *fat = vol->fatCachePrepare(vol->fatStartSector() + sector,
+        FsCache::CACHE_FOR_READ);
+    if(!fat)
+      return -2;
+
+    for(int i = 0; i < perSector; ++i) {
+      uint32_t cluster = first + i;
+      if(cluster < 2)
+        continue;
+      if(cluster > last)
+        break;
+      if(perSector == 256 ? !((const uint16_t *)fat)[i]
+          : !(((const uint32_t *)fat)[i] & 0x0fffffff))
+        ++free;
+    }
+
+    return free;
+  }
+
+  if(volume.m_xVol) {
+    auto *vol = volume.m_xVol;
+
+    // One bit per cluster
+    uint32_t first = sector * 512 * 8;
+    uint32_t count = vol->clusterCount();
+    if(first >= count)
+      return -1;
+
+    const uint8_t *bitmap = vol->bitmapCachePrepare(
+        vol->clusterHeapStartSector()
+          + ((vol->m_bitmapStart - 2) << vol->sectorsPerClusterShift())
+          + sector,
+        FsCache::CACHE_FOR_READ);
+    if(!bitmap)
+      return -2;
+
+    for(int i = 0; i < 512 * 8 && first + i < count; ++i)
+      if(!(bitmap[i / 8] & (1 << (i % 8))))
+        ++free;
+
+    return free;
+  }
+
+  return -2;
+}
+
 void TinyFile::closeLast() {
-  lastFile.close();
-  lastParent.close();
+  if(lastFile && lastId && lastFile.isWritable()) {
+    // Keep the file open: its metadata will be written later.
+    // Only one file can wait, commit the previous one.
+    if(dirtyFile)
+      dirtyFile.close();
+    dirtyFile = lastFile;
+    dirtyId = lastId;
+    forget(lastFile);
+  }
+
+  // Read-only files and directories have nothing to write. Closing them would
+  // flush the volume cache that holds pending updates.
+  if(lastFile && lastFile.isWritable())
+    lastFile.close();
+  else
+    forget(lastFile);
+  forget(lastParent);
+
+  lastId = TinyFile();
   lastMediaId = 0;
 }
 
@@ -155,10 +282,37 @@ void TinyFile::ejected(uint32_t mediaId) {
   if(mediaId == lastMediaId) {
     lastFile = FsFile();
     lastParent = FsFile();
+    lastId = TinyFile();
     lastMediaId = 0;
   }
+  if(dirtyFile && mediaId == dirtyId.mediaId) {
+    // Too late to write anything
+    forget(dirtyFile);
+    dirtyId = TinyFile();
+  }
+}
+
+bool TinyFile::syncDirty() {
+  bool success = true;
+  if(lastFile && lastFile.isWritable())
+    success = lastFile.close();
+  if(dirtyFile) {
+    success = dirtyFile.close() && success;
+    dirtyId = TinyFile();
+  }
+  closeLast();
+  return success;
+}
+
+void TinyFile::forget(FsFile &file) {
+  file.m_fFile = nullptr;
+  file.m_xFile = nullptr;
 }
 
 FsFile TinyFile::lastFile;
 FsFile TinyFile::lastParent;
 uint32_t TinyFile::lastMediaId;
+TinyFile TinyFile::lastId;
+FsFile TinyFile::dirtyFile;
+TinyFile TinyFile::dirtyId;
+uint32_t TinyFile::dirtyTime;
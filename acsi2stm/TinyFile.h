@@ -32,6 +32,13 @@ struct __attribute__((__packed__)) TinyFile {
     return index;
   }
 
+  // Returns true if both point at the same file
+  bool operator==(const TinyFile &other) const {
+    return index == other.index
+      && dirCluster == other.dirCluster
+      && mediaId == other.mediaId;
+  }
+
   // Returns true if the file is in the root directory
   bool isInRoot() const {
     return !dirCluster;
@@ -55,13 +62,25 @@ struct __attribute__((__packed__)) TinyFile {
   // WARNING: returns a reference to a static variable.
   FsFile & openParent(FsVolume &volume) const;
 
-  void close();
+  // Release the file. Commits pending metadata if this file has some.
+  // Returns false if metadata could not be written.
+  bool close();
 
   // These methods do very dirty shenaningans
   // If the SdFat library changes, some fields will need to be adjusted.
   static uint32_t getCluster(FsFile &file);
   static void setCluster(FsFile &file, uint32_t cluster);
 
+  // Returns the raw FAT directory entry of a file that has no long name.
+  // Returns nullptr for long names and exFAT files.
+  static const DirFat_t * getShortEntry(FsFile &file);
+
+  // Count free clusters in one sector of the FAT or exFAT allocation bitmap.
+  // Sectors are numbered from the beginning of the table.
+  // Returns -1 if the sector is past the end of the table, -2 if the table
+  // cannot be read this way.
+  static int32_t countFreeClusters(FsVolume &volume, uint32_t sector);
+
   uint32_t mediaId;
   uint32_t dirCluster;
   uint16_t index;
@@ -74,9 +93,28 @@ struct __attribute__((__packed__)) TinyFile {
   static void closeLast();
   static void ejected(uint32_t mediaId);
 
+  // Write pending metadata (size, dates, FAT) of files opened for writing,
+  // then close all cached files.
+  // Returns false if metadata could not be written.
+  static bool syncDirty();
+
+  // Returns true if metadata updates are pending
+  static bool isDirty() {
+    return dirtyFile || (lastFile && lastFile.isWritable());
+  }
+
+  // Close a file without syncing the volume cache
+  static void forget(FsFile &file);
+
   static FsFile lastFile;
   static FsFile lastParent;
   static uint32_t lastMediaId;
+  static TinyFile lastId; // File currently opened in lastFile
+
+  // File opened for writing, kept open to delay its metadata update
+  static FsFile dirtyFile;
+  static TinyFile dirtyId;
+  static uint32_t dirtyTime; // Timestamp of the first pending update
 };
 
 #endif
@@ -87,6 +87,14 @@ Long Tos::Malloc(ToLong number) {
   return gemdos(Malloc_op, p);
 }
 
+Long Tos::Mxalloc(ToLong amount, ToWord mode) {
+  Mxalloc_p p;
+  p.amount = amount;
+  p.mode = mode;
+  verboseHex("Mxalloc(", (uint32_t)amount, ',', (uint16_t)mode, ")\n");
+  return gemdos(Mxalloc_op, p);
+}
+
 Long Tos::Mfree(ToLong block) {
   Mfree_p p;
   p.block = block;
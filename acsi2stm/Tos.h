@@ -211,6 +211,29 @@ struct Tos: public SysHook {
     char d_fname[14];
   };
 
+  // MiNT file attributes, returned by Fxattr and Dxreaddir
+  struct TOS_PACKED XATTR {
+    Word mode;
+    Long index;
+    Word dev;
+    Word rdev;
+    Word nlink;
+    Word uid;
+    Word gid;
+    Long size;
+    Long blksize;
+    Long nblocks;
+    Word mtime;
+    Word mdate;
+    Word atime;
+    Word adate;
+    Word ctime;
+    Word cdate;
+    Word attr;
+    Word reserved2;
+    Long reserved3[2];
+  };
+
   struct TOS_PACKED PH {
     Word ph_branch; // 0x601a
     Long ph_tlen; // text section length
@@ -342,6 +365,10 @@ struct Tos: public SysHook {
     Word wflag;
     Word attrib;
   };
+  DECLARE_FUNCTION(Mxalloc, 68, (ToLong amount, ToWord mode)) {
+    Long amount;
+    Word mode;
+  };
   DECLARE_FUNCTION(Dgetpath, 71, (char *path, ToWord driveno)) {
     Long path;
     Word driveno;
@@ -418,6 +445,45 @@ struct Tos: public SysHook {
     Word handle;
     Word wflag;
   };
+
+  // MiNT functions
+  DECLARE_FUNCTION(Dopendir, 0x128, (const char *name, ToWord flag)) {
+    Long name;
+    Word flag;
+  };
+  DECLARE_FUNCTION(Dreaddir, 0x129, (ToWord len, ToLong dirhandle, char *buf)) {
+    Word len;
+    Long dirhandle;
+    Long buf;
+  };
+  DECLARE_FUNCTION(Drewinddir, 0x12a, (ToLong dirhandle)) {
+    Long dirhandle;
+  };
+  DECLARE_FUNCTION(Dclosedir, 0x12b, (ToLong dirhandle)) {
+    Long dirhandle;
+  };
+  DECLARE_FUNCTION(Fxattr, 0x12c, (ToWord flag, const char *name, XATTR &xattr)) {
+    Word flag;
+    Long name;
+    Long xattr;
+  };
+  DECLARE_FUNCTION(Dxreaddir, 0x142, (ToWord len, ToLong dirhandle, char *buf, XATTR &xattr, Long &xret)) {
+    Word len;
+    Long dirhandle;
+    Long buf;
+    Long xattr;
+    Long xret;
+  };
+
+  // GemDrive extensions
+
+  // Copy count bytes between 2 GemDrive file handles, on the STM32.
+  // Opcode spells 'A2' so it cannot clash with MiNT or MagiC calls.
+  DECLARE_FUNCTION(Fcopy, 0x4132, (ToWord srchandle, ToWord dsthandle, ToLong count)) {
+    Word srchandle;
+    Word dsthandle;
+    Long count;
+  };
 #undef DECLARE_FUNCTION
 
   // System call templates
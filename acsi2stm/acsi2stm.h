@@ -62,6 +62,21 @@
 // Tries 1MHz to try to make pathological hardware work anyway.
 #define ACSI_SD_MAX_SPEED 50
 
+// Keep the SD card state across ST resets.
+// If the card still answers with the same identification, it is not
+// initialized again: the file system, the disk image and the boot sector are
+// checked again without the slow card initialization sequence.
+// Set to 0 to fully initialize SD cards at each reset.
+#define ACSI_SD_WARM_RESET 1
+
+// Initialize SD slots in the background.
+// Only the first enabled slot is initialized before answering the ACSI bus.
+// The other slots answer NOT READY until the idle loop initializes them.
+// This avoids timeouts with ST boot ROMs that probe the bus very early.
+// GemDrive waits for all slots before assigning drive letters.
+// Set to 0 to initialize all slots before answering the bus.
+#define ACSI_SD_LAZY_INIT 1
+
 // SD card write lock pin behavior (PB0, PB1 and PB3-PB5).
 // In every case, soldering these pins to VCC (+3.3V) will disable the SD slot
 // and free the corresponding ACSI id on the bus.
@@ -132,6 +147,25 @@
 // File name of the hd image
 #define ACSI_IMAGE_FILE "/acsi2stm/hd0.img"
 
+// Number of 512 bytes blocks read in advance during boot in ACSI mode.
+// Block reads following a reset are recorded as runs of consecutive blocks.
+// On the next boot, these runs are read from the SD card between commands and
+// kept in a cache of this many blocks until the ST asks for them.
+// Each block uses 512 bytes of static RAM. Set to 0 to disable.
+#define ACSI_BOOT_PREFETCH 0
+
+// Maximum number of runs of consecutive blocks in the boot recording. Each run
+// uses 16 bytes of static RAM.
+#define ACSI_BOOT_PREFETCH_RUNS 32
+
+// Duration of the boot recording in milliseconds, from the reset
+#define ACSI_BOOT_PREFETCH_TIME 20000
+
+// File name of the boot recording, stored next to the hd image. SD cards
+// without a disk image have nowhere to store it: the recording is then only
+// kept in RAM and replayed after a reset.
+#define ACSI_BOOT_PREFETCH_FILE "/acsi2stm/boot.lba"
+
 // Set to 1 to enable UltraSatan-compatible RTC
 #define ACSI_RTC 1
 
@@ -201,13 +235,120 @@
 // smaller means less memory used by Pexec on the STM32.
 #define ACSI_GEMDRIVE_RELTABLE_CACHE_SIZE 512
 
+// Maximum size in KB of a hidden file, one per drive, that caches decoded
+// relocation tables. The table of each launched program is stored as a bitmap
+// with one bit per 16-bit word of program, keyed by the program location,
+// size and date. Launching the program again patches each block from its
+// bitmap instead of reading the GEMDOS relocation table.
+// The file is emptied when full. Set to 0 to disable.
+#define ACSI_GEMDRIVE_RELOC_CACHE 0
+
+// Path of the relocation cache on each drive.
+#define ACSI_GEMDRIVE_RELOC_CACHE_FILE "/GEMDRIVE.REL"
+
 // Maximum number of files that can be opened at the same time. Consumes static
 // RAM on the STM32. Maximum is 256.
 #define ACSI_GEMDRIVE_MAX_FILES 64
 
+// Maximum number of directories opened with Dopendir at the same time. Each
+// one takes about 60 bytes of static RAM on the STM32.
+// Set to 0 to let TOS answer Dopendir and related MiNT calls.
+#define ACSI_GEMDRIVE_MAX_DIRS 4
+
 // Maximum depth of a path, in folders. Impacts RAM usage on the STM32.
 #define ACSI_GEMDRIVE_MAX_PATH 64
 
+// Number of file buffers used to coalesce small Fwrite calls in STM32 RAM.
+// Each buffer uses ACSI_GEMDRIVE_FILE_BUFFER_SIZE bytes of static RAM.
+// Set to 0 to disable buffering.
+#define ACSI_GEMDRIVE_FILE_BUFFERS 2
+
+// Size of each file buffer in bytes. Writes smaller than this are buffered.
+#define ACSI_GEMDRIVE_FILE_BUFFER_SIZE 512
+
+// Delay in milliseconds after which an unused file buffer, or the pending size
+// and date of a written file, is written to the SD card while the ST is not
+// sending any command.
+#define ACSI_GEMDRIVE_FILE_BUFFER_DELAY 500
+
+// Initial read-ahead window in bytes. File buffers also serve small Fread
+// calls: the window starts at this size and doubles for each sequential refill,
+// up to ACSI_GEMDRIVE_FILE_BUFFER_SIZE.
+// Set to 0 to disable read-ahead.
+#define ACSI_GEMDRIVE_READ_AHEAD_MIN 64
+
+// Number of resolved directory paths kept in cache. Avoids walking through
+// each directory of a path again. Each entry uses about 270 bytes of static
+// RAM. Set to 0 to disable the cache.
+#define ACSI_GEMDRIVE_PATH_CACHE 2
+
+// Number of directories with a hashed index of their file names. Makes file
+// name lookups fast in big directories.
+// Set to 0 to disable indexes.
+#define ACSI_GEMDRIVE_DIR_INDEXES 1
+
+// Number of slots in each directory index. Must be a power of 2.
+// Each slot uses 4 bytes of static RAM. Up to 3/4 of the slots are filled,
+// further names are found by scanning the directory.
+#define ACSI_GEMDRIVE_DIR_INDEX_SIZE 128
+
+// Number of directory listing pages kept in cache. Fsfirst/Fsnext are answered
+// from these pages instead of reading the SD card for each file.
+// Set to 0 to disable the listing cache.
+#define ACSI_GEMDRIVE_LISTINGS 2
+
+// Number of files in each directory listing page. Each file uses 22 bytes of
+// static RAM.
+#define ACSI_GEMDRIVE_LISTING_SIZE 16
+
+// Size in bytes of the boot recording.
+// During boot, GemDrive records the paths passed to GEMDOS calls and stores
+// them in a file at the root of the boot drive. On the next boot, these paths
+// are resolved in advance while the ST runs code, filling the path cache,
+// directory indexes and listings just before the calls need them. Needs
+// ACSI_GEMDRIVE_PATH_CACHE or ACSI_GEMDRIVE_DIR_INDEXES.
+// Uses twice this amount of static RAM. Set to 0 to disable boot recording.
+#define ACSI_GEMDRIVE_BOOT_RECORD 0
+
+// Path of the boot recording on the boot drive. The file is only rewritten if
+// the boot sequence changed.
+#define ACSI_GEMDRIVE_BOOT_RECORD_FILE "/GEMDRIVE.BOO"
+
+// Duration of the boot recording in milliseconds, from the driver
+// initialization.
+#define ACSI_GEMDRIVE_BOOT_RECORD_TIME 20000
+
+// Number of Fsnext results prepared in advance and stored in ST RAM by the
+// resident driver. The ST answers these Fsnext calls by itself, without any
+// ACSI transfer. Uses 44 bytes of ST RAM per result. Ignored in PIO mode.
+// Set to 0 to disable.
+#define ACSI_GEMDRIVE_ST_PREFETCH 16
+
+// Size in bytes of the Fread cache stored in ST RAM by the resident driver.
+// Small Fread calls are served by the ST from this cache, without any ACSI
+// transfer. Hit counters are available through the 'A2RC' cookie.
+// Maximum is 4076. Ignored in PIO mode. Set to 0 to disable.
+#define ACSI_GEMDRIVE_ST_READ_CACHE 1024
+
+// Minimum size in bytes reserved as a contiguous cluster run when a program
+// starts writing an empty file. Bigger writes reserve their full size.
+// Unused space is released when the file is closed.
+// Set to 0 to disable preallocation.
+#define ACSI_GEMDRIVE_PREALLOCATE 65536
+
+// Size in bytes of the buffer used to batch small memory writes in a single
+// hook command. The ST runs the batch just before the next command, so a
+// small write followed by a return takes a single exchange.
+// Ignored in PIO mode. Set to 0 to disable.
+#define ACSI_GEMDRIVE_HOOK_SCRIPT 128
+
+// Size in bytes of a ST RAM buffer used to transfer data to and from memory
+// that is outside DMA range, such as TT-RAM. Data is transfered by DMA through
+// this buffer, then the ST copies it. Only allocated if the ST has TT-RAM.
+// Must be a multiple of 16. Needs ACSI_GEMDRIVE_HOOK_SCRIPT.
+// Ignored in PIO mode. Set to 0 to disable.
+#define ACSI_GEMDRIVE_BOUNCE_BUFFER 8192
+
 // Disable direct DMA access in GemDrive (used for testing/debug)
 // Simulates how GemDrive works with TT-RAM on a ST
 #define ACSI_GEMDRIVE_NO_DIRECT_DMA 0
@@ -104,7 +104,9 @@ void loop() {
 #endif
 
     Monitor::ledOff();
-    uint8_t cmd = DmaPort::waitCommand();
+    while(!DmaPort::pollCommand())
+      Devices::onIdle();
+    uint8_t cmd = DmaPort::readCommand();
     Monitor::ledOn();
 
     // Parse command and device
@@ -0,0 +1,41 @@
+; ACSI2STM Atari hard drive emulator
+; Copyright (C) 2019-2024 by Jean-Matthieu Coulon
+
+; This program is free software: you can redistribute it and/or modify
+; it under the terms of the GNU General Public License as published by
+; the Free Software Foundation, either version 3 of the License, or
+; (at your option) any later version.
+
+; This program is distributed in the hope that it will be useful,
+; but WITHOUT ANY WARRANTY; without even the implied warranty of
+; MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+; GNU General Public License for more details.
+
+; You should have received a copy of the GNU General Public License
+; along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+; Resident driver uploaded by the STM32 after booting from boot.s
+; The header must stay identical to boot.s: the STM32 patches it at the same
+; offsets.
+
+	incdir	..\inc\
+	include	tos.i
+
+EXT	equ	1                       ; Enable driver extensions
+
+start:
+
+	bra.w	syshook.rts             ; Not executed
+
+prmoff	dc.w	$00ff                   ;
+	dc.l	'XBRA','A2ST'           ;
+oldvec	dc.l	$00000084               ; Old vector
+	move.l	oldvec(pc),-(sp)        ; Push old vector
+acsiid	moveq	#$0e,d0                 ; Set command (patched by code)
+
+	include	syshook.s               ; Enter syshook mode
+	include	ext.s                   ; Extensions
+
+	end
+
+; vim: ff=dos ts=8 sw=8 sts=8 noet colorcolumn=8,41,81 ft=asm68k tw=80
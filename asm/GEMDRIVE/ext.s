@@ -0,0 +1,236 @@
+; ACSI2STM Atari hard drive emulator
+; Copyright (C) 2019-2024 by Jean-Matthieu Coulon
+
+; This program is free software: you can redistribute it and/or modify
+; it under the terms of the GNU General Public License as published by
+; the Free Software Foundation, either version 3 of the License, or
+; (at your option) any later version.
+
+; This program is distributed in the hope that it will be useful,
+; but WITHOUT ANY WARRANTY; without even the implied warranty of
+; MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+; GNU General Public License for more details.
+
+; You should have received a copy of the GNU General Public License
+; along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+; Resident driver extensions
+; Answers some system calls directly on the ST, using data pushed in advance
+; by the STM32. Too big for the boot sector: only available in the driver
+; uploaded by the STM32 and in GEMDRIVE.PRG.
+; Must be included right after syshook.s, with EXT defined.
+
+; Fsnext prefetch buffer header
+pf.dta	equ	0                       ; DTA the batch belongs to
+pf.next	equ	4                       ; Next DTA image
+pf.left	equ	8                       ; Number of images left (word)
+pf.end	equ	10                      ; Directory ends after the batch (word)
+pf.img	equ	12                      ; DTA images. The first one is the DTA
+	                                ; returned by the STM32.
+
+dta.len	equ	44                      ; DTA size
+
+; Fread cache header
+rc.hits	equ	0                       ; Fread calls served by the ST
+rc.miss	equ	4                       ; Small Fread calls served by the STM32
+rc.hdl	equ	8                       ; Cached handle, 0 if none (word)
+rc.left	equ	12                      ; Bytes left in the cache
+rc.next	equ	16                      ; Next byte to return
+rc.data	equ	20                      ; Cached data
+
+; Filter map
+fm.ops	equ	128                     ; Number of opcodes in the map
+fm.fwd	equ	0                       ; Forward to TOS
+fm.send	equ	1                       ; Send to the STM32
+fm.hdl	equ	2                       ; Send if the handle belongs to GemDrive
+fm.path	equ	3                       ; Send if the path is on a GemDrive drive
+
+bp.drv	equ	$37                     ; Current drive in the basepage
+
+ext.filter:
+	; Process a system call on the ST if possible
+	; Input:
+	;  a2: system call parameters
+	;  d0.b: command byte
+	; Exits through syshook.sendcmd if the STM32 must process the call,
+	; through syshook.forward if GemDrive doesn't process the call,
+	; or through syshook.return with the return value in d0.
+
+	move.w	(a2),d1                 ; d1 = opcode
+	cmp.w	#fm.ops,d1              ; Opcodes out of the map are always sent
+	bhs.b	ext.st                  ;
+
+	lea	ext.fmap(pc),a1         ; Read 2 bits in the filter map
+	move.w	d1,d2                   ;
+	lsr.w	#2,d2                   ;
+	move.b	0(a1,d2.w),d2           ;
+	and.w	#3,d1                   ;
+	add.w	d1,d1                   ;
+	lsr.b	d1,d2                   ;
+	and.w	#3,d2                   ;
+
+	subq.w	#fm.hdl,d2              ; Dispatch the filter
+	bmi.b	ext.send                ;
+	beq.b	ext.hdl                 ;
+
+	; fm.path: check the drive of the path
+	move.l	2(a2),a0                ; a0 = path
+	moveq	#$1f,d2                 ; Drive letter to drive number
+	cmp.b	#':',1(a0)              ;
+	bne.b	.curdrv                 ;
+	and.b	(a0),d2                 ;
+	subq.w	#1,d2                   ;
+	bra.b	.drive                  ;
+
+.curdrv	move.l	ext.prun(pc),a0         ; Relative path: use the current drive
+	move.l	(a0),a0                 ;
+	moveq	#0,d2                   ;
+	move.b	bp.drv(a0),d2           ;
+
+.drive	move.l	ext.drives(pc),d1       ; Check GemDrive drives
+	btst	d2,d1                   ;
+	beq.b	ext.fwd                 ;
+	bra.b	ext.st                  ;
+
+ext.hdl:
+	; fm.hdl: check the file handle
+	move.b	2(a2),d2                ; Handle prefix to unit number
+	sub.b	#$32,d2                 ;
+	cmp.b	#7,d2                   ;
+	bhi.b	ext.fwd                 ;
+	move.b	ext.hdls(pc),d1         ; Check GemDrive units
+	btst	d2,d1                   ;
+	bne.b	ext.st                  ;
+
+ext.fwd:
+	bra.w	syshook.forward         ; Let TOS process the call
+
+ext.send:
+	addq.w	#fm.hdl,d2              ; Restore the filter value
+	beq.b	ext.fwd                 ; fm.fwd: let TOS process the call
+
+ext.st:
+	; Try to process the call on the ST
+	cmp.w	#$004f,(a2)             ; Fsnext
+	beq.b	ext.fsnext              ;
+
+	cmp.w	#$003f,(a2)             ; Fread
+	beq.w	ext.fread               ;
+	bra.b	ext.stm32               ;
+
+ext.fsnext:
+	; Fsnext: copy the next prefetched DTA image
+	move.l	ext.pfbuf(pc),d1        ; a1 = prefetch buffer
+	beq.b	ext.stm32               ;
+	move.l	d1,a1                   ;
+
+	tst.l	pf.left(a1)             ; Check pf.left and pf.end at once
+	beq.b	ext.stm32               ; Nothing prefetched
+
+	move.l	ext.prun(pc),a0         ; a0 = DTA of the current process
+	move.l	(a0),a0                 ;
+	move.l	$20(a0),a0              ;
+	move.l	a0,d1                   ;
+	btst	#0,d1                   ; Odd DTA: let the STM32 handle it
+	bne.b	ext.stm32               ;
+	cmp.l	pf.dta(a1),d1           ; The batch must belong to this DTA
+	bne.b	ext.stm32               ;
+
+	move.l	pf.next(a1),a1          ; The DTA must still hold the image
+	lea	-dta.len(a1),a1         ; preceding the next one
+	moveq	#dta.len/4-1,d2         ;
+.cmp	cmpm.l	(a1)+,(a0)+             ;
+	dbne	d2,.cmp                 ;
+	bne.b	ext.stm32               ;
+
+	; The call is processed on the ST from now on
+
+	move.l	d1,a0                   ; a0 = DTA
+	move.l	ext.pfbuf(pc),a2        ; a2 = prefetch buffer
+
+	moveq	#-49,d0                 ; ENMFIL if the batch is finished
+	tst.w	pf.left(a2)             ;
+	beq.b	.ret                    ;
+
+	subq.w	#1,pf.left(a2)          ; Consume one image
+	move.l	pf.next(a2),a1          ;
+	add.l	#dta.len,pf.next(a2)    ;
+
+	moveq	#dta.len/4-1,d2         ; Copy the image to the DTA
+.cpy	move.l	(a1)+,(a0)+             ;
+	dbra	d2,.cpy                 ;
+
+	moveq	#0,d0                   ; E_OK
+.ret	bra.w	syshook.return          ;
+
+ext.stm32:
+	; Let the STM32 process the call
+	; Use command $0d instead of $0e if the current process changed since
+	; the last call sent to this unit.
+	move.l	ext.prun(pc),d1         ; a0 = p_run
+	beq.b	.send                   ; Not initialized yet
+	move.l	d1,a0                   ;
+	move.b	d0,d2                   ; a1 = last basepage sent to this unit
+	lsr.b	#3,d2                   ;
+	and.w	#$1c,d2                 ;
+	lea	ext.bps(pc),a1          ;
+	add.w	d2,a1                   ;
+	move.l	(a0),d1                 ; Compare with the current basepage
+	cmp.l	(a1),d1                 ;
+	beq.b	.send                   ;
+	move.l	d1,(a1)                 ;
+	subq.b	#1,d0                   ; Command $0d
+.send	bra.w	syshook.sendcmd         ;
+
+ext.fread:
+	; Fread: copy data from the read cache
+	move.l	ext.rcbuf(pc),d1        ; a1 = read cache
+	beq.b	ext.stm32               ;
+	move.l	d1,a1                   ;
+
+	move.w	2(a2),d1                ; The handle must be the cached one
+	beq.b	ext.stm32               ;
+	cmp.w	rc.hdl(a1),d1           ;
+	bne.b	ext.stm32               ;
+
+	move.l	4(a2),d2                ; d2 = byte count
+	cmp.l	rc.left(a1),d2          ; Unsigned compare also sends negative
+	bhi.b	ext.stm32               ; counts to the STM32
+
+	; The call is processed on the ST from now on
+
+	addq.l	#1,rc.hits(a1)          ; Update statistics
+	sub.l	d2,rc.left(a1)          ; Consume cached data
+	move.l	rc.next(a1),a0          ; a0 = source
+	add.l	d2,rc.next(a1)          ;
+	move.l	8(a2),a2                ; a2 = destination
+	move.l	d2,d0                   ; Return the byte count
+
+	bra.b	.start                  ; Copy data
+.cpy	move.b	(a0)+,(a2)+             ;
+.start	dbra	d2,.cpy                 ;
+
+	bra.w	syshook.return          ;
+
+; Variables
+; Layout must match GemDriverVars in GemDrive.h
+ext.vars	dc.l	'A2EX'          ; Marker to find variables
+ext.self	dc.l	0               ; Address of ext.vars, set by init
+ext.prun	dc.l	0               ; Address of p_run, set by the STM32
+ext.pfbuf	dc.l	0               ; Fsnext prefetch buffer, 0 if none
+ext.pfsize	dc.l	0               ; Size of a buffer provided by the driver
+ext.rcbuf	dc.l	0               ; Fread cache, 0 if none
+ext.rcsize	dc.l	0               ; Size of a buffer provided by the driver
+ext.drives	dc.l	0               ; GemDrive drives, for fm.path
+ext.hdls	dc.b	0               ; Bit n set if handles $32+n are GemDrive
+	dc.b	0                       ; Reserved
+ext.fmap	dc.l	$55555555,$55555555,$55555555,$55555555 ; Filter map, 2 bits
+	dc.l	$55555555,$55555555,$55555555,$55555555 ; per opcode. Send all
+	                                ; calls until the STM32 sets it.
+ext.bounce	dc.l	0               ; ST RAM bounce buffer, 0 if none
+ext.bncsize	dc.l	0               ; Size of the bounce buffer
+
+; Private variables
+ext.bps	dc.l	0,0,0,0,0,0,0,0 ; Last basepage sent to each ACSI id
+
+; vim: ff=dos ts=8 sw=8 sts=8 noet colorcolumn=8,41,81 ft=asm68k tw=80
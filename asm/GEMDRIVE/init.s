@@ -87,6 +87,17 @@ main	lea	stack,sp                ; Initialize stack
 
 	; Enter syshook mode to run onInit on the STM32
 
+	ifd	EXT
+	lea	ext.vars(pc),a2         ; Let the STM32 read the driver variables
+	move.l	a2,ext.self-ext.vars(a2);
+	lea	pfbuf(pc),a0            ; Provide the prefetch buffer
+	move.l	a0,ext.pfbuf-ext.vars(a2)
+	move.l	#PFSIZE,ext.pfsize-ext.vars(a2)
+	lea	rcbuf(pc),a0            ; Provide the read cache
+	move.l	a0,ext.rcbuf-ext.vars(a2)
+	move.l	#RCSIZE,ext.rcsize-ext.vars(a2)
+	endc
+
 	move.b	d7,d0                   ;
 	bsr	syshook.init
 
@@ -106,7 +117,7 @@ main	lea	stack,sp                ; Initialize stack
 
 .nxtid	add.b	#$20,d7                 ; Point at next ACSI id
 	cmp.b	#$20,d7                 ;
-	bhi.b	.test                   ; Try next ACSI id
+	bhi.w	.test                   ; Try next ACSI id
 
 	; Installation finished for all devices
 
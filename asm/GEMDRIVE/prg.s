@@ -33,11 +33,18 @@
 	text
 
 XBRA	equ	'A2ST'                  ; XBRA marker
+EXT	equ	1                       ; Enable driver extensions
 BOOTCMD	equ	$11                     ; Boot command
 
 start	bra.w	main                    ; Initialization is in the freed zone
 
 	include	syshook.s
+	include	ext.s
+
+PFSIZE	equ	pf.img+dta.len*17       ; Room for 16 prefetched DTA
+pfbuf	ds.b	PFSIZE                  ; Fsnext prefetch buffer
+RCSIZE	equ	rc.data+1024            ; 1KB Fread cache
+rcbuf	ds.b	RCSIZE                  ; Fread cache
 
 prmoff	dc.w	$0006                   ; Detected during initialization
 
@@ -47,6 +47,10 @@ syshook:
 	cmp.w	#$0020,(a2)             ; Don't hook Super because it breaks
 	beq.b	syshook.forward         ; some programs such as ICDFMT.PRG
 
+	ifd	EXT
+	bra.w	ext.filter              ; Try to process the call on the ST
+	endc
+
 syshook.sendcmd:
 	st	flock.w                 ; Lock floppy controller
 	bsr.w	syshook.setdmaaddr      ; Set DMA address on chip
@@ -107,10 +111,9 @@ syshook.setprm:
 .usp	move	usp,a2                  ; Point at USP directly
 	rts
 
-syshook.execcmd:
-	; Received a command in d0
-
-	; Read parameter (4 bytes) into d1
+syshook.rdprm:
+	; Read a 4 bytes parameter into d1
+	; Alters d2 only
 	swap	d0                      ; Save command byte into upper d0
 	moveq	#3,d2                   ; Repeat 4 times
 .rdbyte	move.w	(a0),d0                 ; Fast byte read (no ack)
@@ -118,6 +121,12 @@ syshook.execcmd:
 	move.b	d0,d1                   ;
 	dbra	d2,.rdbyte              ;
 	swap	d0                      ; Restore command byte
+	rts
+
+syshook.execcmd:
+	; Received a command in d0
+
+	bsr.b	syshook.rdprm           ; Read parameter into d1
 
 	; Route the call using a jump table
 	move.b	d0,d2                   ; Jump table for command byte
@@ -136,12 +145,155 @@ syshook.execcmd:
 	dc.w	syshook.pshword-.jmptbl ; $92
 	dc.w	syshook.pushsp-.jmptbl  ; $94
 	dc.w	syshook.trap01-.jmptbl  ; $96
+	dc.w	syshook.script-.jmptbl  ; $98
 
 syshook.rte
 	; Command $80: Return long from exception
 	move.l	d1,d0                   ; Put parameter in d0
 	bra.b	syshook.return          ; Return from exception
 
+syshook.script:
+	; Commands $98/$99: Run a script
+	; Operations are read in fast mode after the parameter
+.op	move.w	(a0),d2                 ; Read operation byte
+	subq.b	#1,d2                   ;
+	bmi.b	.end                    ; $00: End of script
+	beq.b	.rte                    ; $01: Return long from exception
+	subq.b	#1,d2                   ;
+
+	ifd	EXT
+	; Operations only available in the resident driver
+	beq.b	.store                  ; $02: Store bytes
+	subq.b	#1,d2                   ;
+	beq.b	.copy                   ; $03: Copy memory
+	subq.b	#1,d2                   ;
+	bne.w	.fill                   ; $05: Fill memory
+
+	; $04: End of script, set DMA address
+	bsr.b	syshook.rdprm           ; Read DMA address
+	bra.w	syshook.dmaset          ;
+	endc
+
+.store	bsr.b	syshook.rdprm           ; $02: Store bytes. Read target address
+	move.l	d1,a2                   ;
+	bsr.b	syshook.rdprm           ; Read byte count - 1
+	move.w	d1,d2                   ;
+.cpy	move.w	(a0),d1                 ; Fast byte read into memory
+	move.b	d1,(a2)+                ;
+	dbra	d2,.cpy                 ;
+	bra.b	.op                     ;
+
+.rte	bsr.b	syshook.rdprm           ; Read return value
+	bra.b	syshook.rte             ;
+
+.end	bra.w	syshook.dmasp           ; Set DMA on the stack and continue
+
+	ifd	EXT
+.copy	bsr.b	syshook.rdprm           ; Read source address
+	move.l	d1,-(sp)                ;
+	bsr.b	syshook.rdprm           ; Read target address
+	move.l	d1,a2                   ;
+	bsr.b	syshook.rdprm           ; Read byte count
+	movem.l	d0/a0-a1,-(sp)          ; Free registers
+	move.l	12(sp),a1               ; Point a1 at the source
+
+	move.w	a1,d0                   ; Check alignment
+	move.w	a2,d2                   ;
+	eor.w	d2,d0                   ;
+	btst	#0,d0                   ;
+	bne.b	.bnext                  ; Different parity: copy bytes
+	btst	#0,d2                   ;
+	beq.b	.align                  ; Both even: copy longs
+	tst.l	d1                      ; Both odd: copy one byte first
+	beq.b	.cpyend                 ;
+	move.b	(a1)+,(a2)+             ;
+	subq.l	#1,d1                   ;
+
+.align	move.w	d1,d0                   ; Keep byte count for the tail
+	lsr.l	#2,d1                   ; Number of longs to copy
+	moveq	#7,d2                   ; Longs that don't fill a whole block
+	and.w	d1,d2                   ;
+	lsr.l	#3,d1                   ; Number of 32 bytes blocks
+	neg.w	d2                      ; Jump inside the unrolled loop
+	add.w	d2,d2                   ;
+	jmp	.lnext(pc,d2.w)         ;
+
+.lcpy	move.l	(a1)+,(a2)+             ; Unrolled long copy
+	move.l	(a1)+,(a2)+             ;
+	move.l	(a1)+,(a2)+             ;
+	move.l	(a1)+,(a2)+             ;
+	move.l	(a1)+,(a2)+             ;
+	move.l	(a1)+,(a2)+             ;
+	move.l	(a1)+,(a2)+             ;
+	move.l	(a1)+,(a2)+             ;
+.lnext	subq.l	#1,d1                   ;
+	bpl.b	.lcpy                   ;
+
+	btst	#1,d0                   ; Copy the last 3 bytes
+	beq.b	.tail                   ;
+	move.w	(a1)+,(a2)+             ;
+.tail	btst	#0,d0                   ;
+	beq.b	.cpyend                 ;
+	move.b	(a1)+,(a2)+             ;
+	bra.b	.cpyend                 ;
+
+.bcpy	move.b	(a1)+,(a2)+             ; Byte copy
+.bnext	subq.l	#1,d1                   ;
+	bpl.b	.bcpy                   ;
+
+.cpyend	movem.l	(sp)+,d0/a0-a1          ; Restore registers
+	addq.l	#4,sp                   ; Pop source address
+	bra.w	.op                     ;
+
+.fill	bsr.w	syshook.rdprm           ; Read target address
+	move.l	d1,a2                   ;
+	bsr.w	syshook.rdprm           ; Read byte count
+	move.l	d1,a1                   ;
+	bsr.w	syshook.rdprm           ; Read value, repeated 4 times
+	move.l	d1,d2                   ;
+	move.l	a1,d1                   ;
+	move.l	d0,-(sp)                ; Save command byte
+
+	move.w	a2,d0                   ; Check alignment
+	btst	#0,d0                   ;
+	beq.b	.faln                   ;
+	tst.l	d1                      ; Odd address: fill one byte first
+	beq.b	.fend                   ;
+	move.b	d2,(a2)+                ;
+	subq.l	#1,d1                   ;
+
+.faln	move.w	d1,a1                   ; Keep byte count for the tail
+	lsr.l	#2,d1                   ; Number of longs to fill
+	moveq	#7,d0                   ; Longs that don't fill a whole block
+	and.w	d1,d0                   ;
+	lsr.l	#3,d1                   ; Number of 32 bytes blocks
+	neg.w	d0                      ; Jump inside the unrolled loop
+	add.w	d0,d0                   ;
+	jmp	.fnext(pc,d0.w)         ;
+
+.flong	move.l	d2,(a2)+                ; Unrolled long fill
+	move.l	d2,(a2)+                ;
+	move.l	d2,(a2)+                ;
+	move.l	d2,(a2)+                ;
+	move.l	d2,(a2)+                ;
+	move.l	d2,(a2)+                ;
+	move.l	d2,(a2)+                ;
+	move.l	d2,(a2)+                ;
+.fnext	subq.l	#1,d1                   ;
+	bpl.b	.flong                  ;
+
+	move.w	a1,d0                   ; Fill the last 3 bytes
+	btst	#1,d0                   ;
+	beq.b	.ftail                  ;
+	move.w	d2,(a2)+                ;
+.ftail	btst	#0,d0                   ;
+	beq.b	.fend                   ;
+	move.b	d2,(a2)+                ;
+
+.fend	move.l	(sp)+,d0                ; Restore command byte
+	bra.w	.op                     ;
+	endc
+
 syshook.pexec4:
 	; Command $88: Pexec4 and rte
 	moveq	#4,d0
@@ -21,6 +21,7 @@
 	include	tfcropen.s
 	include	tfileio.s
 	include	tfilecpy.s
+	include	tfcopy.s
 	include	tfrename.s
 	include	tfattrib.s
 	include	tfdatime.s
@@ -82,6 +83,7 @@ main:
 	bsr	tfcropen
 	bsr	tfileio
 	bsr	tfilecpy
+	bsr	tfcopy
 	bsr	tfrename
 	bsr	tfattrib
 	bsr	tfdatime
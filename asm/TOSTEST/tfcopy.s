@@ -0,0 +1,266 @@
+; ACSI2STM Atari hard drive emulator
+; Copyright (C) 2019-2024 by Jean-Matthieu Coulon
+
+; This program is free software: you can redistribute it and/or modify
+; it under the terms of the GNU General Public License as published by
+; the Free Software Foundation, either version 3 of the License, or
+; (at your option) any later version.
+
+; This program is distributed in the hope that it will be useful,
+; but WITHOUT ANY WARRANTY; without even the implied warranty of
+; MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+; GNU General Public License for more details.
+
+; You should have received a copy of the GNU General Public License
+; along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+; Tests the GemDrive Fcopy extension and compares its speed with a
+; Fread/Fwrite copy loop
+
+tfcopy:
+	print	.desc
+
+	bsr	.clean                  ; Cleanup and set drive
+
+	lea	.ncreat,a5              ; Create files
+
+	pea	.topdir                 ; Create top directory
+	gemdos	Dcreate,6               ;
+
+	clr.w	-(sp)                   ; Create source file
+	pea	.sfile                  ;
+	gemdos	Fcreate,8               ;
+	move.w	d0,d3                   ; d3 = source file descriptor
+
+	bmi	testfailed              ;
+
+	move.l	#'5678',d0              ; Fill the buffer with dummy data
+	bsr	fillbuf                 ;
+
+	lea	.nwrite,a5              ; Fill source file with 4 buffers
+	moveq	#3,d5                   ;
+.fill	pea	buffer                  ;
+	move.l	#65536,-(sp)            ;
+	move.w	d3,-(sp)                ;
+	gemdos	Fwrite,12               ;
+	cmp.l	#65536,d0               ;
+	bne	testfailed              ;
+	dbra	d5,.fill                ;
+
+	lea	.nclose,a5              ; Close source file
+	move.w	d3,-(sp)                ;
+	gemdos	Fclose,4                ;
+	tst.w	d0                      ;
+	bmi	testfailed              ;
+
+	; Reference copy through ST RAM
+
+	lea	.dfile1,a4              ; Open files
+	bsr	.open                   ;
+
+	bsr	.timer                  ; d6 = start time
+	move.l	d0,d6                   ;
+
+.rwcopy	lea	.nread,a5               ; Read a buffer
+	pea	buffer                  ;
+	move.l	#65536,-(sp)            ;
+	move.w	d3,-(sp)                ;
+	gemdos	Fread,12                ;
+	tst.l	d0                      ;
+	bmi	testfailed              ;
+	beq.b	.rwdone                 ;
+
+	move.l	d0,d5                   ; Write it
+	lea	.nwrite,a5              ;
+	pea	buffer                  ;
+	move.l	d5,-(sp)                ;
+	move.w	d4,-(sp)                ;
+	gemdos	Fwrite,12               ;
+	cmp.l	d5,d0                   ;
+	bne	testfailed              ;
+	bra.b	.rwcopy                 ;
+
+.rwdone	bsr	.timer                  ; Print elapsed time
+	print	.trw                    ;
+	bsr	.ptime                  ;
+
+	bsr	.close                  ;
+
+	; Copy on the STM32
+
+	lea	.dfile2,a4              ; Open files
+	bsr	.open                   ;
+
+	bsr	.timer                  ; d6 = start time
+	move.l	d0,d6                   ;
+
+	lea	.ncopy,a5               ; Copy up to the end of the source
+	move.l	#$7fffffff,-(sp)        ;
+	move.w	d4,-(sp)                ;
+	move.w	d3,-(sp)                ;
+	gemdos	Fcopy,10                ;
+
+	cmp.l	#EINVFN,d0              ; Not a GemDrive drive
+	beq	.nofcpy                 ;
+
+	cmp.l	#4*65536,d0             ;
+	bne	testfailed              ;
+
+	bsr	.timer                  ; Print elapsed time
+	print	.tcopy                  ;
+	bsr	.ptime                  ;
+
+	bsr	.close                  ;
+
+	lea	.nopen,a5               ; Check copied data
+	clr.w	-(sp)                   ;
+	pea	.dfile2                 ;
+	gemdos	Fopen,8                 ;
+	move.w	d0,d3                   ;
+	bmi	testfailed              ;
+
+	lea	.ndata,a5               ;
+	moveq	#3,d5                   ;
+.check	bsr	clrbuf                  ;
+	pea	buffer                  ;
+	move.l	#65536,-(sp)            ;
+	move.w	d3,-(sp)                ;
+	gemdos	Fread,12                ;
+	cmp.l	#65536,d0               ;
+	bne	testfailed              ;
+	cmp.l	#'5678',buffer          ;
+	bne	testfailed              ;
+	cmp.l	#'5678',buffer+65536-4  ;
+	bne	testfailed              ;
+	dbra	d5,.check               ;
+
+	lea	.nclose,a5              ;
+	move.w	d3,-(sp)                ;
+	gemdos	Fclose,4                ;
+	tst.w	d0                      ;
+	bmi	testfailed              ;
+
+	bsr	.clean                  ; Cleanup
+
+	bra	testok
+
+.nofcpy	print	.nsupp                  ; Fcopy is optional
+	bsr	.close                  ;
+	bsr	.clean                  ;
+	bra	testok                  ;
+
+.open	; Open the source file in d3 and create the file at a4 in d4
+	lea	.nopen,a5               ;
+	clr.w	-(sp)                   ;
+	pea	.sfile                  ;
+	gemdos	Fopen,8                 ;
+	move.w	d0,d3                   ;
+	bmi	testfailed              ;
+
+	lea	.ncreat,a5              ;
+	clr.w	-(sp)                   ;
+	pea	(a4)                    ;
+	gemdos	Fcreate,8               ;
+	move.w	d0,d4                   ;
+	bmi	testfailed              ;
+
+	rts
+
+.close	; Close d3 and d4
+	lea	.nclose,a5              ;
+
+	move.w	d3,-(sp)                ;
+	gemdos	Fclose,4                ;
+	tst.w	d0                      ;
+	bmi	testfailed              ;
+
+	move.w	d4,-(sp)                ;
+	gemdos	Fclose,4                ;
+	tst.w	d0                      ;
+	bmi	testfailed              ;
+
+	rts
+
+.timer	; Read the 200Hz system timer in d0
+	pea	.rdhz                   ;
+	xbios	Supexec,6               ;
+	rts
+
+.rdhz	move.l	hz200.w,d0              ; 200Hz timer
+	rts
+
+.ptime	; Print the time elapsed since d6, in milliseconds
+	sub.l	d6,d0                   ; 5ms per tick
+	move.l	d0,d1                   ;
+	lsl.l	#2,d0                   ;
+	add.l	d1,d0                   ;
+	moveq	#1,d1                   ;
+	bsr	tui.puint               ;
+	print	.ms                     ;
+	rts
+
+.clean	; Cleanup routine
+	; Must converge to a clean state if executed multiple times
+
+	move.w	drive,-(sp)             ; Switch to test drive
+	gemdos	Dsetdrv,4               ;
+
+	pea	.root                   ; Dsetpath '\'
+	gemdos	Dsetpath,6              ;
+
+	pea	.sfile                  ; Delete files
+	gemdos	Fdelete,6               ;
+	pea	.dfile1                 ;
+	gemdos	Fdelete,6               ;
+	pea	.dfile2                 ;
+	gemdos	Fdelete,6               ;
+
+	pea	.topdir                 ; Delete test directory
+	gemdos	Ddelete,6               ;
+
+	rts
+
+
+.desc	dc.b	'Test Fcopy',$0d,$0a
+	dc.b	0
+
+.trw	dc.b	'  Fread/Fwrite: ',0
+.tcopy	dc.b	'  Fcopy: ',0
+.ms	dc.b	' ms',$0d,$0a
+	dc.b	0
+
+.nsupp	dc.b	'  Fcopy not supported on this drive',$0d,$0a
+	dc.b	0
+
+.nread	dc.b	'Error while reading',$0d,$0a
+	dc.b	0
+
+.nwrite	dc.b	'Error while writing',$0d,$0a
+	dc.b	0
+
+.ncopy	dc.b	'Error while copying',$0d,$0a
+	dc.b	0
+
+.ndata	dc.b	'Copied data is wrong',$0d,$0a
+	dc.b	0
+
+.ncreat	dc.b	'Could not create file',$0d,$0a
+	dc.b	0
+
+.nopen	dc.b	'Could not open file',$0d,$0a
+	dc.b	0
+
+.nclose	dc.b	'Could not close file',$0d,$0a
+	dc.b	0
+
+.root	dc.b	'\',0
+
+.topdir	dc.b	'\TFCOPY.TMP',0
+
+.sfile	dc.b	'\TFCOPY.TMP\SOURCE',0
+.dfile1	dc.b	'\TFCOPY.TMP\DEST1',0
+.dfile2	dc.b	'\TFCOPY.TMP\DEST2',0
+
+	even
+
+; vim: ff=dos ts=8 sw=8 sts=8 noet colorcolumn=8,41,81 ft=asm68k tw=80
@@ -114,6 +114,7 @@ Fsfirst=78
 Fsnext=79
 Frename=86
 Fdatime=87
+Fcopy=$4132                             ; GemDrive extension
 
 ; BIOS system call
 bios	macro
@@ -138,6 +139,7 @@ Floprd=8
 Flopwr=9
 Flopfmt=10
 Random=17
+Supexec=38
 
 ; System variables
 flock=$43e                              ; Floppy semaphore
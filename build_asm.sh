@@ -39,6 +39,23 @@ buildasm() {
     echo
   fi
 
+  if [ -e "$1/drv.s" ]; then
+    name="$(basename "$1")"
+    echo "Compile $name resident driver"
+    [ -d "$builddir/$name" ] || mkdir -p "$builddir/$name" || exit $?
+    vasmm68k_mot $VASMFLAGS -Fbin -I"$builddir" -L "$builddir/$name.drv.lst" -o "$builddir/$name.drv.bin" "$srcdir/$name/drv.s" || exit $?
+    [ -e "$builddir/$name.drv.bin" ] || exit $?
+
+    echo "Generate Arduino source code from the binary blob"
+
+    (
+      cd "$builddir"
+      xxd -i "$name.drv.bin" > "$name.drv.h"
+    )
+    cp "$builddir/$name.drv.h" "$srcdir/../acsi2stm/"
+    echo
+  fi
+
   if [ -e "$1/tos.s" ]; then
     name="$(basename "$1")"
     echo "Compile $name.TOS"